@@ -0,0 +1,141 @@
+/*
+  ==============================================================================
+
+    Shared settings, signals and timing for the benchmarks. Every benchmark is a
+    juce::UnitTest in the "Benchmarks" category: the expect() calls check that a
+    faster path still produces the reference output, and the timings are logged.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+
+namespace benchmark
+{
+    static constexpr const char* category = "Benchmarks";
+
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 512;
+
+    // ten seconds of audio per run
+    static constexpr int numSamples = 480000;
+
+    // every filter engaged, with the bands spread out and clearly boosted or cut
+    inline ChainSettings makeSettings(juce::Random& random, int numBands = 3)
+    {
+        ChainSettings settings;
+        settings.numBands = numBands;
+
+        settings.lowCutFreq = 20.f + 180.f * random.nextFloat();
+        settings.highCutFreq = 8000.f + 8000.f * random.nextFloat();
+        settings.lowCutSlope = Slope_24;
+        settings.highCutSlope = Slope_24;
+
+        for (int i = 0; i < maxBands; ++i)
+        {
+            auto& band = settings.bands[(size_t) i];
+            band.freq = 60.f * std::pow(200.f, random.nextFloat());
+            band.gainInDecibels = (random.nextBool() ? 1.f : -1.f) * (2.f + 10.f * random.nextFloat());
+            band.quality = 0.5f + 3.5f * random.nextFloat();
+        }
+
+        return settings;
+    }
+
+    inline void fillWithNoise(juce::AudioBuffer<float>& buffer, juce::Random& random)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* samples = buffer.getWritePointer(channel);
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                samples[i] = 0.5f * (2.f * random.nextFloat() - 1.f);
+        }
+    }
+
+    inline float getMaxDifference(const float* a, const float* b, int length)
+    {
+        auto difference = 0.f;
+        for (int i = 0; i < length; ++i)
+            difference = juce::jmax(difference, std::abs(a[i] - b[i]));
+
+        return difference;
+    }
+
+    inline float getMaxDifference(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+    {
+        jassert(a.getNumChannels() == b.getNumChannels() && a.getNumSamples() == b.getNumSamples());
+
+        auto difference = 0.f;
+        for (int channel = 0; channel < a.getNumChannels(); ++channel)
+            difference = juce::jmax(difference, getMaxDifference(a.getReadPointer(channel), b.getReadPointer(channel), a.getNumSamples()));
+
+        return difference;
+    }
+
+    // the best of a few runs in seconds, so a stray context switch doesn't skew the result
+    template<typename Function>
+    double timeBestOf(int numRuns, Function&& function)
+    {
+        auto best = std::numeric_limits<double>::max();
+
+        for (int run = 0; run < numRuns; ++run)
+        {
+            const auto start = juce::Time::getMillisecondCounterHiRes();
+            function();
+            best = juce::jmin(best, (juce::Time::getMillisecondCounterHiRes() - start) * 0.001);
+        }
+
+        return best;
+    }
+
+    // how many times faster than real time the given seconds of processing ran
+    inline double getRealtimeFactor(double seconds, int numProcessedSamples = numSamples)
+    {
+        return (numProcessedSamples / sampleRate) / seconds;
+    }
+
+    struct Comparison
+    {
+        float maxDifference = 0.f;
+        double referenceSeconds = 0.0, candidateSeconds = 0.0;
+    };
+
+    /*
+     the skeleton every benchmark shares. Both paths process a copy of the input in place,
+     starting from whatever state they were set up in, and the candidate has to match the
+     reference to within tolerance. Then each is timed over fresh copies and the result logged.
+     A path that has to start from a particular state resets itself
+     */
+    template<typename Reference, typename Candidate>
+    Comparison compareWithReference(juce::UnitTest& test, const juce::String& label,
+                                    const juce::AudioBuffer<float>& input, float tolerance,
+                                    const juce::String& referenceName, Reference&& reference,
+                                    const juce::String& candidateName, Candidate&& candidate,
+                                    int numRuns = 5)
+    {
+        Comparison result;
+
+        juce::AudioBuffer<float> referenceOutput, candidateOutput;
+        referenceOutput.makeCopyOf(input);
+        candidateOutput.makeCopyOf(input);
+        reference(referenceOutput);
+        candidate(candidateOutput);
+
+        result.maxDifference = getMaxDifference(referenceOutput, candidateOutput);
+        test.expectLessThan(result.maxDifference, tolerance, candidateName + " has to produce the " + referenceName + " output");
+
+        juce::AudioBuffer<float> work;
+        result.referenceSeconds = timeBestOf(numRuns, [&] { work.makeCopyOf(input, true); reference(work); });
+        result.candidateSeconds = timeBestOf(numRuns, [&] { work.makeCopyOf(input, true); candidate(work); });
+
+        test.logMessage(label + juce::String::formatted(": %s %.1f ms, %s %.1f ms, %.2fx the speed, max difference %g",
+                                                        referenceName.toRawUTF8(), result.referenceSeconds * 1000.0,
+                                                        candidateName.toRawUTF8(), result.candidateSeconds * 1000.0,
+                                                        result.referenceSeconds / result.candidateSeconds,
+                                                        (double) result.maxDifference));
+        return result;
+    }
+}
@@ -0,0 +1,33 @@
+/*
+  ==============================================================================
+
+    Runs every benchmark and equivalence check, or only the ones whose names
+    contain the first argument. Exits with 1 if any check failed.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "BenchmarkHelpers.h"
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedNoDenormals noDenormals;
+    const juce::String filter = argc > 1 ? juce::String (argv[1]) : juce::String();
+    
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+    
+    juce::Array<juce::UnitTest*> tests;
+    for (auto* test : juce::UnitTest::getTestsInCategory (benchmark::category))
+        if (filter.isEmpty() || test->getName().containsIgnoreCase (filter))
+            tests.add (test);
+    
+    runner.runTests (tests);
+    
+    int numFailures = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult (i)->failures;
+    
+    return numFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    MultiChannelChain, one channel per SIMD lane, against the scalar fallback of
+    one FilterCascade<float> per channel that builds without SIMD run.
+
+  ==============================================================================
+*/
+
+#include "BenchmarkHelpers.h"
+
+struct MultiChannelChainBenchmark : juce::UnitTest
+{
+    MultiChannelChainBenchmark() : juce::UnitTest("MultiChannelChain vs scalar cascades", benchmark::category) {}
+
+    void runTest() override
+    {
+        for (auto numChannels : { 2, 4, 8 })
+        {
+            beginTest(juce::String(numChannels) + " channels");
+            runChannels(numChannels);
+        }
+    }
+
+    void runChannels(int numChannels)
+    {
+        using namespace benchmark;
+
+        juce::Random random(numChannels);
+        const auto settings = makeSettings(random);
+        const auto coefficients = makeChainCoefficients(settings, sampleRate);
+
+        juce::AudioBuffer<float> input(numChannels, numSamples);
+        fillWithNoise(input, random);
+
+        std::vector<std::unique_ptr<FilterCascade<float>>> scalarChains;
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            scalarChains.push_back(std::make_unique<FilterCascade<float>>());
+            scalarChains.back()->setCoefficients(coefficients);
+            scalarChains.back()->setBypassStates(settings);
+        }
+
+        // the worker threads are left out, this measures the lanes alone
+        MultiChannelChain chain;
+        chain.prepare(numChannels, blockSize, false);
+        chain.setCoefficients(coefficients, coefficients, 0);
+        chain.setBypassStates(settings, settings);
+
+        auto processScalar = [&](juce::AudioBuffer<float>& buffer)
+        {
+            for (int start = 0; start < numSamples; start += blockSize)
+                for (int channel = 0; channel < numChannels; ++channel)
+                    scalarChains[(size_t) channel]->process(buffer.getWritePointer(channel, start), juce::jmin(blockSize, numSamples - start));
+        };
+
+        auto processLanes = [&](juce::AudioBuffer<float>& buffer)
+        {
+            juce::dsp::AudioBlock<float> block(buffer);
+            for (int start = 0; start < numSamples; start += blockSize)
+                chain.process(block.getSubBlock((size_t) start, (size_t) juce::jmin(blockSize, numSamples - start)));
+        };
+
+        compareWithReference(*this, juce::String::formatted("%d channels, %d lanes", numChannels, MultiChannelChain::numLanes),
+                             input, 1.0e-5f, "scalar", processScalar, "SIMD", processLanes);
+    }
+};
+
+static MultiChannelChainBenchmark multiChannelChainBenchmark;
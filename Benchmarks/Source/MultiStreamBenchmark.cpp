@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    MultiStreamEQ driving hundreds of independent streams, each with its own
+    settings, against one FilterCascade<float> per stream.
+
+  ==============================================================================
+*/
+
+#include "BenchmarkHelpers.h"
+
+struct MultiStreamBenchmark : juce::UnitTest
+{
+    MultiStreamBenchmark() : juce::UnitTest("MultiStreamEQ vs scalar cascades", benchmark::category) {}
+
+    void runTest() override
+    {
+        for (auto numStreams : { 256, 512 })
+        {
+            beginTest(juce::String(numStreams) + " streams");
+            runStreams(numStreams);
+        }
+    }
+
+    void runStreams(int numStreams)
+    {
+        using namespace benchmark;
+
+        // half a second per stream keeps hundreds of streams in memory
+        const auto streamLength = (int) sampleRate / 2;
+
+        juce::Random random(numStreams);
+
+        std::vector<std::unique_ptr<FilterCascade<float>>> scalarChains;
+        MultiStreamEQ streams;
+        streams.prepare(numStreams, sampleRate);
+
+        for (int stream = 0; stream < numStreams; ++stream)
+        {
+            const auto settings = makeSettings(random, 1 + random.nextInt(maxBands));
+            streams.setStreamSettings(stream, settings);
+
+            scalarChains.push_back(std::make_unique<FilterCascade<float>>());
+            scalarChains.back()->setCoefficients(makeChainCoefficients(settings, sampleRate));
+            scalarChains.back()->setBypassStates(settings);
+        }
+
+        // every stream back to back in one channel, streamLength samples apart
+        juce::AudioBuffer<float> input(1, numStreams * streamLength);
+        fillWithNoise(input, random);
+
+        auto processScalar = [&](juce::AudioBuffer<float>& buffer)
+        {
+            for (int start = 0; start < streamLength; start += blockSize)
+                for (int stream = 0; stream < numStreams; ++stream)
+                    scalarChains[(size_t) stream]->process(buffer.getWritePointer(0, stream * streamLength + start), juce::jmin(blockSize, streamLength - start));
+        };
+
+        auto processStreams = [&](juce::AudioBuffer<float>& buffer)
+        {
+            for (int start = 0; start < streamLength; start += blockSize)
+                streams.process(buffer.getWritePointer(0, start), streamLength, juce::jmin(blockSize, streamLength - start));
+        };
+
+        const auto result = compareWithReference(*this, juce::String::formatted("%d streams, %d lanes", numStreams, MultiStreamEQ::numLanes),
+                                                 input, 1.0e-5f, "scalar", processScalar, "MultiStreamEQ", processStreams, 3);
+
+        // everything runs on this thread, so real time over the streams is what one core sustains
+        logMessage(juce::String::formatted("streams per core: scalar %.0f, MultiStreamEQ %.0f",
+                                           getRealtimeFactor(result.referenceSeconds, streamLength) * numStreams,
+                                           getRealtimeFactor(result.candidateSeconds, streamLength) * numStreams));
+    }
+};
+
+static MultiStreamBenchmark multiStreamBenchmark;
@@ -0,0 +1,15 @@
+/*
+  ==============================================================================
+
+    The plugin's own sources, built into the benchmarks without a plugin wrapper
+    around them. The wrapper is what would normally define the plugin's name.
+
+  ==============================================================================
+*/
+
+#ifndef JucePlugin_Name
+ #define JucePlugin_Name "SimpleEQ"
+#endif
+
+#include "../../Source/PluginProcessor.cpp"
+#include "../../Source/PluginEditor.cpp"
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    The SVF engine against biquads holding the same responses, as
+    toBiquadCoefficients converts them, run through the biquad kernels.
+
+  ==============================================================================
+*/
+
+#include "BenchmarkHelpers.h"
+
+struct SVFBenchmark : juce::UnitTest
+{
+    SVFBenchmark() : juce::UnitTest("SVF engine vs biquad kernels", benchmark::category) {}
+
+    void runTest() override
+    {
+        for (auto numBands : { 1, maxBands })
+        {
+            beginTest(juce::String(numBands) + " bands");
+            runBands(numBands);
+        }
+    }
+
+    void runBands(int numBands)
+    {
+        using namespace benchmark;
+
+        juce::Random random(numBands);
+        const auto settings = makeSettings(random, numBands);
+
+        // the SVF design fills the biquad sections with their equivalents, so switching
+        // the engine over runs the same responses through the biquad kernels
+        const auto svfCoefficients = makeChainCoefficients(settings, sampleRate, FilterEngine::svf);
+        auto biquadCoefficients = svfCoefficients;
+        biquadCoefficients.engine = FilterEngine::biquad;
+
+        FilterCascade<float> svfChain, biquadChain;
+        svfChain.setCoefficients(svfCoefficients);
+        svfChain.setBypassStates(settings);
+        biquadChain.setCoefficients(biquadCoefficients);
+        biquadChain.setBypassStates(settings);
+
+        juce::AudioBuffer<float> input(1, numSamples);
+        fillWithNoise(input, random);
+
+        auto process = [](FilterCascade<float>& chain, juce::AudioBuffer<float>& buffer)
+        {
+            for (int start = 0; start < numSamples; start += blockSize)
+                chain.process(buffer.getWritePointer(0, start), juce::jmin(blockSize, numSamples - start));
+        };
+
+        // the topologies round differently, so they only agree to within float precision
+        compareWithReference(*this, juce::String(numBands) + " bands", input, 1.0e-3f,
+                             "biquad", [&](auto& buffer) { process(biquadChain, buffer); },
+                             "SVF", [&](auto& buffer) { process(svfChain, buffer); });
+    }
+};
+
+static SVFBenchmark svfBenchmark;
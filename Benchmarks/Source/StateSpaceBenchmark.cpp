@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    The single channel state space path against the direct form kernels it
+    stands in for, with both engines and with block lengths that leave
+    remainders for the kernels to pick up.
+
+  ==============================================================================
+*/
+
+#include "BenchmarkHelpers.h"
+
+struct StateSpaceBenchmark : juce::UnitTest
+{
+    StateSpaceBenchmark() : juce::UnitTest("State space vs direct form", benchmark::category) {}
+
+    void runTest() override
+    {
+        beginTest("biquad engine");
+        runEngine(FilterEngine::biquad);
+
+        beginTest("SVF engine");
+        runEngine(FilterEngine::svf);
+    }
+
+    void runEngine(FilterEngine engine)
+    {
+        using namespace benchmark;
+
+        juce::Random random(engine == FilterEngine::svf ? 2 : 1);
+        const auto settings = makeSettings(random);
+        const auto nextSettings = makeSettings(random);
+
+        FilterCascade<float> directChain, stateSpaceChain;
+        stateSpaceChain.setStateSpaceEnabled(true);
+
+        auto setSettings = [&](const ChainSettings& chainSettings)
+        {
+            const auto coefficients = makeChainCoefficients(chainSettings, sampleRate, engine);
+            for (auto* chain : { &directChain, &stateSpaceChain })
+            {
+                chain->setCoefficients(coefficients);
+                chain->setBypassStates(chainSettings);
+            }
+        };
+
+        juce::AudioBuffer<float> input(1, numSamples);
+        fillWithNoise(input, random);
+
+        // odd lengths, so every block ends on a remainder the direct form kernels finish off,
+        // and halfway through the settings change under the running states
+        auto process = [&](FilterCascade<float>& chain, juce::AudioBuffer<float>& buffer)
+        {
+            setSettings(settings);
+            chain.reset();
+
+            juce::Random lengths(42);
+            auto changed = false;
+
+            for (int start = 0; start < numSamples;)
+            {
+                if (!changed && start >= numSamples / 2)
+                {
+                    setSettings(nextSettings);
+                    changed = true;
+                }
+
+                const auto length = juce::jmin(1 + 2 * lengths.nextInt(blockSize / 2), numSamples - start);
+                chain.process(buffer.getWritePointer(0, start), length);
+                start += length;
+            }
+        };
+
+        // the matrices accumulate rounding differently from the recursions
+        compareWithReference(*this, engine == FilterEngine::svf ? "SVF" : "biquad", input, 1.0e-4f,
+                             "direct form", [&](auto& buffer) { process(directChain, buffer); },
+                             "state space", [&](auto& buffer) { process(stateSpaceChain, buffer); });
+    }
+};
+
+static StateSpaceBenchmark stateSpaceBenchmark;
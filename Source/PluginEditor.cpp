@@ -235,34 +235,33 @@ juce::String RotarySliderWithLabels::getDisplayString() const
 //==============================================================================
 void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
 {
-    juce::AudioBuffer<float> tempIncomingBuffer;
+    const auto windowSize = monoBuffer.getNumSamples();
     
-    while (channelFifo->getNumCompleteBuffersAvailable() > 0)
+    // a hop the ring can't hold would never become available
+    const auto hopSize = juce::jlimit(1, juce::jmax(1, channelFifo->getCapacity()), hopScheduler.getHopSize(windowSize, sampleRate));
+    bool frameDue = false;
+    
+    // the ring is read a hop at a time, so each window ends on a hop boundary however the host
+    // sliced the audio. a partial hop stays in the ring until the next tick
+    while (channelFifo->getNumSamplesAvailable() >= hopSize)
     {
-        if (channelFifo->getAudioBuffer(tempIncomingBuffer))
-        {
-            auto size = tempIncomingBuffer.getNumSamples();
-                        
-                        // shift old samples in monoBuffer
-                        juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-                                                          monoBuffer.getReadPointer(0, size),
-                                                          monoBuffer.getNumSamples() - size);
-                        
-                        // copy new samples to monoBuffer
-                        juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-                                                          tempIncomingBuffer.getReadPointer(0, 0),
-                                                          size);
-                        
-                        channelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.f);
-        }
+        // shift old samples in monoBuffer
+        if (hopSize < windowSize)
+            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
+                                              monoBuffer.getReadPointer(0, hopSize),
+                                              windowSize - hopSize);
+        
+        // pull the new hop onto the end of monoBuffer
+        channelFifo->pull(monoBuffer.getWritePointer(0, windowSize - hopSize), hopSize);
+        frameDue = true;
     }
     
     /*
-     if there are FFT buffers to pull
-        if we can pull a buffer
-            generate a path
-     
+     only the newest due window is ever shown, so it's the only one transformed. hops
+     that arrive faster than the timer just slide the window along
      */
+    if (frameDue)
+        channelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.f);
 
     auto fftSize = channelFFTDataGenerator.getFFTSize();
     
@@ -272,27 +271,10 @@ void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
     
     const auto binWidh = sampleRate / (double) fftSize;
     
-    while (channelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0)
-    {
-        std::vector<float> fftData;
-        if (channelFFTDataGenerator.getFFTData(fftData))
-        {
-            pathProducer.generatePath(fftData, fftBounds, fftSize, binWidh, -48.f);
-        }
-    }
-    
-    /*
-     while there are paths that can be pull
-        pull as many as we can
-            display the most recent path
-     */
-    
-    while (pathProducer.getNumPathsAvailable() > 0)
-    {
-        pathProducer.getPath(ChannelFFTPath);
-    }
-    
+    if (auto* fftData = channelFFTDataGenerator.getLatestFFTData())
+        pathProducer.generatePath(*fftData, fftBounds, fftSize, binWidh, -48.f);
     
+    pathProducer.getLatestPath(ChannelFFTPath);
 }
 
 
@@ -312,11 +294,16 @@ rightPathProducer(audioProcessor.rightChannelFifo)
     
     shouldShowFFTAnalysis = true;
     
+    // the processor only feeds its analyzer fifos while someone is reading them
+    audioProcessor.addAnalyzerConsumer();
+    
     updateCurve();
     startTimerHz(30);
 }
 ResponseCurveComponent::~ResponseCurveComponent()
 {
+    audioProcessor.removeAnalyzerConsumer();
+    
     // remove listeners to all parameters
     const auto& params = audioProcessor.getParameters();
     for( auto param : params)
@@ -341,7 +328,8 @@ void ResponseCurveComponent::timerCallback()
         rightPathProducer.process(fftBounds, sampleRate);
     }
     
-    if ( parametersChanged.compareAndSetBool(false, true) )
+    // the oversampling factor is applied a moment after its parameter changes
+    if ( parametersChanged.compareAndSetBool(false, true) || audioProcessor.getDesignSampleRate() != curveSampleRate )
     {
 //        DBG( "params changed " );
         updateCurve(); // update the monochain
@@ -352,31 +340,12 @@ void ResponseCurveComponent::timerCallback()
 
 void ResponseCurveComponent::updateCurve()
 {
-    auto chainSettings = getChainSettings(audioProcessor.getAPVTS());
-    auto sampleRate = audioProcessor.getSampleRate();
-    
-    // update bypass states
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    monoChain.setBypassed<ChainPositions::Band1>(chainSettings.band1Bypassed);
-    monoChain.setBypassed<ChainPositions::Band2>(chainSettings.band2Bypassed);
-    monoChain.setBypassed<ChainPositions::Band3>(chainSettings.band3Bypassed);
-    
-    //update coefficients
-    auto band1Coefficients = makeBand1Filter(chainSettings, sampleRate);
-    auto band2Coefficients = makeBand2Filter(chainSettings, sampleRate);
-    auto band3Coefficients = makeBand3Filter(chainSettings, sampleRate);
-    
-    updateCoefficients(monoChain.get<Band1>().coefficients, band1Coefficients);
-    updateCoefficients(monoChain.get<Band2>().coefficients, band2Coefficients);
-    updateCoefficients(monoChain.get<Band3>().coefficients, band3Coefficients);
-    
-    // calculate cut filters' coefficients
-    auto lowCutCoefficients = makeLowCutFilter( chainSettings, sampleRate);
-    auto highCutCoefficients = makeHighCutFilter( chainSettings, sampleRate);
-    // update low cut filter chains
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+    auto chainSettings = audioProcessor.getChainSettings();
+    
+    // designed at the processor's rate, so with oversampling the highs don't cramp here either
+    curveSampleRate = audioProcessor.getDesignSampleRate();
+    curveSettings = chainSettings;
+    curveCoefficients = makeChainCoefficients(chainSettings, curveSampleRate);
 }
 
 void ResponseCurveComponent::paint (juce::Graphics& g)
@@ -388,14 +357,7 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
     // draw background grid
     g.drawImage(background, getLocalBounds().toFloat());
     
-    // get chain element
-    auto& lowcut = monoChain.get<ChainPositions::LowCut>();
-    auto& band1 = monoChain.get<ChainPositions::Band1>();
-    auto& band2 = monoChain.get<ChainPositions::Band2>();
-    auto& band3 = monoChain.get<ChainPositions::Band3>();
-    auto& highcut = monoChain.get<ChainPositions::HighCut>();
-    
-    auto sampleRate = audioProcessor.getSampleRate();
+    auto sampleRate = curveSampleRate;
     
     // create a vector to store the magnitude response curve
     std::vector<double> mags;
@@ -408,38 +370,7 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
         auto freq = juce::mapToLog10(double(i) / double(w), 20.0, 20000.0);
         
         // update curve
-        if (!monoChain.isBypassed<ChainPositions::Band1>())
-            mag *= band1.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        
-        if (!monoChain.isBypassed<ChainPositions::Band2>())
-            mag *= band2.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        
-        if (!monoChain.isBypassed<ChainPositions::Band3>())
-            mag *= band3.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        
-        if (!monoChain.isBypassed<ChainPositions::LowCut>())
-        {
-            if (!lowcut.isBypassed<0>())
-                mag *= lowcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowcut.isBypassed<1>())
-                mag *= lowcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowcut.isBypassed<2>())
-                mag *= lowcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowcut.isBypassed<3>())
-                mag *= lowcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
-        
-        if (!monoChain.isBypassed<ChainPositions::HighCut>())
-        {
-            if (!highcut.isBypassed<0>())
-                mag *= highcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!highcut.isBypassed<1>())
-                mag *= highcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!highcut.isBypassed<2>())
-                mag *= highcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!highcut.isBypassed<3>())
-                mag *= highcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
+        mag *= getMagnitudeForFrequency(curveCoefficients, curveSettings, freq, sampleRate);
 
         // store the magnitude in dB for current frequency
         mags[i] = juce::Decibels::gainToDecibels(mag);
@@ -30,7 +30,9 @@ struct FFTDataGenerator
     {
         const auto fftSize = getFFTSize();
         
-        fftData.assign(fftData.size(), 0);
+        //the transform runs straight in the write slot; an unread older spectrum is simply replaced
+        auto& fftData = fftDataMailbox.getWriteSlot();
+        std::fill(fftData.begin(), fftData.end(), 0.f);
         auto* readIndex = audioData.getReadPointer(0);
         std::copy(readIndex, readIndex + fftSize, fftData.begin());
         
@@ -64,7 +66,7 @@ struct FFTDataGenerator
             fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
         }
         
-        fftDataFifo.push(fftData);
+        fftDataMailbox.publish();
     }
     
     void changeOrder(FFTOrder newOrder)
@@ -78,24 +80,23 @@ struct FFTDataGenerator
         
         forwardFFT = std::make_unique<juce::dsp::FFT>(order);
         window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
-        
-        fftData.clear();
-        fftData.resize(fftSize * 2, 0);
 
-        fftDataFifo.prepare(fftData.size());
+        fftDataMailbox.prepareSlots([fftSize](BlockType& slot) { slot.assign((size_t) fftSize * 2, 0.f); });
     }
     //==============================================================================
     int getFFTSize() const { return 1 << order; }
-    int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
     //==============================================================================
-    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
+    //the newest spectrum published since the last call, or nullptr. it stays valid until the next call
+    const BlockType* getLatestFFTData()
+    {
+        return fftDataMailbox.acquire() ? &fftDataMailbox.getReadSlot() : nullptr;
+    }
 private:
     FFTOrder order;
-    BlockType fftData;
     std::unique_ptr<juce::dsp::FFT> forwardFFT;
     std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
     
-    Fifo<BlockType> fftDataFifo;
+    LatestValueMailbox<BlockType> fftDataMailbox;
 };
 
 template<typename PathType>
@@ -116,7 +117,9 @@ struct AnalyzerPathGenerator
 
         int numBins = (int)fftSize / 2;
 
-        PathType p;
+        //build the path in the write slot; clear() keeps the storage from the last time round
+        auto& p = pathMailbox.getWriteSlot();
+        p.clear();
         p.preallocateSpace(3 * (int)fftBounds.getWidth());
 
         auto map = [bottom, top, negativeInfinity](float v)
@@ -152,20 +155,20 @@ struct AnalyzerPathGenerator
             }
         }
 
-        pathFifo.push(p);
-    }
-
-    int getNumPathsAvailable() const
-    {
-        return pathFifo.getNumAvailableForReading();
+        pathMailbox.publish();
     }
 
-    bool getPath(PathType& path)
+    //swaps in the newest path if one was published since the last call
+    bool getLatestPath(PathType& path)
     {
-        return pathFifo.pull(path);
+        if( !pathMailbox.acquire() )
+            return false;
+        
+        std::swap(path, pathMailbox.getReadSlot());
+        return true;
     }
 private:
-    Fifo<PathType> pathFifo;
+    LatestValueMailbox<PathType> pathMailbox;
 };
 //==============================================================================
 
@@ -250,6 +253,33 @@ private:
     juce::RangedAudioParameter* param;
     juce::String suffix;
 };
+/*
+ decides when the analyzer transforms, counted in samples of audio rather than host
+ buffers, so the rate doesn't follow the host's block size. the hop comes from either an
+ overlap fraction of the fft size or a frames-per-second target, and never exceeds the
+ fft size so every sample lands in some window
+ */
+struct HopScheduler
+{
+    void setOverlap(float overlapFraction)
+    {
+        overlap = juce::jlimit(0.f, 0.9375f, overlapFraction);
+        framesPerSecond = 0.0;
+    }
+    
+    void setFramesPerSecond(double fps) { framesPerSecond = juce::jmax(0.0, fps); }
+    
+    int getHopSize(int fftSize, double sampleRate) const
+    {
+        if (framesPerSecond > 0.0 && sampleRate > 0.0)
+            return juce::jlimit(1, fftSize, juce::roundToInt(sampleRate / framesPerSecond));
+        
+        return juce::jlimit(1, fftSize, juce::roundToInt((float) fftSize * (1.f - overlap)));
+    }
+private:
+    float overlap = 0.5f;
+    double framesPerSecond = 0.0;
+};
 //==============================================================================
 struct PathProducer
 {
@@ -267,10 +297,16 @@ struct PathProducer
     void process(juce::Rectangle<float> fftBounds, double sampleRate);
     juce::Path getPath() {return ChannelFFTPath; }
     
+    // e.g. 0.5 or 0.75 of the fft size
+    void setOverlap(float overlapFraction) { hopScheduler.setOverlap(overlapFraction); }
+    // overrides the overlap until setOverlap() is called again
+    void setFramesPerSecond(double fps) { hopScheduler.setFramesPerSecond(fps); }
+    
 private:
     SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>* channelFifo;
     
     juce::AudioBuffer<float> monoBuffer;
+    HopScheduler hopScheduler;
     
     FFTDataGenerator<std::vector<float>> channelFFTDataGenerator;
     
@@ -302,7 +338,10 @@ private:
     SimpleEQAudioProcessor& audioProcessor;
     juce::Atomic<bool> parametersChanged {false};
     
-    MonoChain monoChain;
+    // the main chain's design, settings and rate, refreshed by updateCurve()
+    ChainCoefficients curveCoefficients;
+    ChainSettings curveSettings;
+    double curveSampleRate = 0.0;
     
     void updateCurve();
     
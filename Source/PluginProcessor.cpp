@@ -9,6 +9,22 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+#if JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#elif JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <semaphore.h>
+ #include <cerrno>
+#endif
+
+#if JUCE_INTEL
+ #include <emmintrin.h>
+#endif
+
 //==============================================================================
 SimpleEQAudioProcessor::SimpleEQAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -16,16 +32,26 @@ SimpleEQAudioProcessor::SimpleEQAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
                        )
 #endif
 {
+    for (auto* param : getParameters())
+        param->addListener(this);
+    
+    designThread->addTimeSliceClient(this);
 }
 
 SimpleEQAudioProcessor::~SimpleEQAudioProcessor()
 {
+    designThread->removeTimeSliceClient(this);
+    cancelPendingUpdate();
+    
+    for (auto* param : getParameters())
+        param->removeListener(this);
 }
 
 //==============================================================================
@@ -63,7 +89,8 @@ bool SimpleEQAudioProcessor::isMidiEffect() const
 
 double SimpleEQAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    auto sampleRate = getSampleRate();
+    return sampleRate > 0.0 ? tailLengthSamples.load() / sampleRate : 0.0;
 }
 
 int SimpleEQAudioProcessor::getNumPrograms()
@@ -97,19 +124,82 @@ void SimpleEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlo
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
     
-    juce::dsp::ProcessSpec spec;
+    // a mono track gets a single scalar chain instead of a half empty stereo one
+    const auto newNumChannels = getMainBusNumOutputChannels();
+    const auto newMonoLayout = newNumChannels == 1;
+    
+    // the cascade runs at the oversampled rate, between the up and down sampling stages
+    const auto oversamplingOrder = juce::jlimit(0, 2, juce::roundToInt(oversamplingChoice->load()));
+    std::unique_ptr<juce::dsp::Oversampling<float>> newOversampler;
+    
+    if (oversamplingOrder > 0)
+    {
+        newOversampler = std::make_unique<juce::dsp::Oversampling<float>>((size_t) newNumChannels, (size_t) oversamplingOrder,
+                                                                          juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR,
+                                                                          true, true);
+        newOversampler->initProcessing((size_t) samplesPerBlock);
+    }
+    
+    const auto factor = 1 << oversamplingOrder;
+    
+    // a lone channel has no neighbours to share SIMD lanes with, so it runs in blocks of samples instead.
+    // so does every channel of an offline render on a build without SIMD
+    leftChain.reset();
+    leftChain.setStateSpaceEnabled(newMonoLayout);
+    channelChains.prepare(newMonoLayout ? 0 : newNumChannels, samplesPerBlock * factor, workerThreadsEnabled);
+    channelChains.setStateSpaceEnabled(isNonRealtime());
+    
+    silentSamples = 0;
+    sleeping = false;
+    
+    // the sample rate may have changed, so every filter has to be redesigned. The design thread
+    // reads the layout and the oversampler too, so they only change while it is locked out
+    {
+        const juce::ScopedLock sl(designLock);
+        numChannels = newNumChannels;
+        monoLayout = newMonoLayout;
+        oversampler = std::move(newOversampler);
+        preparedOversamplingOrder = oversamplingOrder;
+        oversamplingFactor = factor;
+        oversamplerLatencySamples = oversampler != nullptr ? juce::roundToInt(oversampler->getLatencyInSamples()) : 0;
+        oversamplerTailSamples = oversamplerLatencySamples + oversamplingOrder * halfBandSettlingSamples;
+        designSampleRate = sampleRate * factor;
+        publishedDesignSampleRate = designSampleRate;
+        filtersNeedFullUpdate = true;
+        prepareLinearPhase(sampleRate, samplesPerBlock);
+    }
+    designCoefficients();
+    
+    setLatencySamples(getCurrentLatencySamples());
+    
+    numSmoothingSteps = juce::roundToInt(smoothingTimeSeconds * sampleRate * factor / controlBlockSize);
+    samplesUntilRefresh = 0;
     
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = 1;
-    spec.sampleRate = sampleRate;
+    // the fresh design replaces anything earlier events left in force
+    eventSettingsActive = false;
+    if (coefficientMailbox.acquire())
+        applyCoefficients(coefficientMailbox.getReadSlot(), 0);
     
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    updateBypassStates(getStereoSettings());
     
-    updateFilters();
+    // the detectors run at the host rate, before any oversampling
+    for (auto& detector : detectors)
+        detector.prepare(sampleRate);
     
-    leftChannelFifo.prepare(samplesPerBlock);
-    rightChannelFifo.prepare(samplesPerBlock);
+    detectionBuffer.setSize(2, samplesPerBlock);
+    
+    // the analyzer buffers are only allocated while an editor is there to read them. The editor
+    // reads them on the message thread, so a new block size turns the tap off here and leaves
+    // reallocating them to handleAsyncUpdate()
+    if (analyzerBlockSize.exchange(samplesPerBlock) != samplesPerBlock)
+    {
+        {
+            const juce::SpinLock::ScopedLockType lock(analyzerLock);
+            analyzerTapActive.store(false, std::memory_order_release);
+        }
+        
+        triggerAsyncUpdate();
+    }
     
 //    osc.initialise([](float x) {return std::sin(x);});
 //
@@ -132,18 +222,19 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // any layout works, from mono and stereo up to surround and ambisonic beds,
+    // as long as there is at least one channel
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+    
+    // the sidechain only keys the dynamic bands' detectors, so mono or stereo will do
+    if (layouts.inputBuses.size() > 1 && layouts.getChannelSet(true, 1).size() > 2)
+        return false;
    #endif
 
     return true;
@@ -168,27 +259,128 @@ void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-    updateFilters();
+    // pick up coefficients published by the designer thread, if there are any,
+    // and glide to them unless there is nothing playing to glide on
+    if (coefficientMailbox.acquire())
+    {
+        // a fresh design from the parameters takes over from whatever earlier events set
+        eventSettingsActive = false;
+        applyCoefficients(coefficientMailbox.getReadSlot(), sleeping ? 0 : numSmoothingSteps);
+    }
+    
+    const auto stereoSettings = eventSettingsActive ? eventSettings : getStereoSettings();
+    updateBypassStates(stereoSettings);
+    channelChains.setMidSide(isMidSide());
+    prepareDetection(buffer, stereoSettings);
+    
+    // only the main bus is equalised, the sidechain is just listened to
+    auto mainBuffer = getBusBuffer(buffer, false, 0);
+    
+    // a neutral instance doesn't touch the buffer at all, not even to look for silence
+    if (isPassThrough())
+    {
+        pushToAnalyzer(mainBuffer);
+        return;
+    }
+    
+    // once the input has been silent for longer than the filters ring, stop processing
+    if (mainBuffer.getMagnitude(0, mainBuffer.getNumSamples()) < silenceThreshold)
+    {
+        if (!sleeping)
+        {
+            silentSamples += mainBuffer.getNumSamples();
+            
+            if (silentSamples > tailLengthSamples.load(std::memory_order_relaxed))
+            {
+                // the filter states have decayed into the noise floor, clear them so no denormals linger
+                resetFilters();
+                sleeping = true;
+            }
+        }
+    }
+    else
+    {
+        silentSamples = 0;
+        sleeping = false;
+    }
     
-    juce::dsp::AudioBlock<float> block(buffer);
+    juce::dsp::AudioBlock<float> block(mainBuffer);
     
 //    buffer.clear();
 //    juce::dsp::ProcessContextReplacing<float> stereoContext(block);
 //    osc.process(stereoContext);
     
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    if (isLinearPhase())
+    {
+        // timestamped events only steer the minimum phase cascade
+        numParameterEvents = 0;
+        
+        if (!sleeping)
+            processLinearPhase(block);
+    }
+    else if (numParameterEvents > 0 || !sleeping)
+    {
+        // while sleeping the silent input simply passes straight through
+        processOversampled(block);
+    }
     
-    // context wrapper around the audio blocks
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+    pushToAnalyzer(mainBuffer);
+}
+
+void SimpleEQAudioProcessor::pushToAnalyzer(const juce::AudioBuffer<float>& buffer)
+{
+    // with no editor open, or the analyzer switched off, this is the whole cost of the tap
+    if (!analyzerTapActive.load(std::memory_order_acquire) || analyzerEnabled->load(std::memory_order_relaxed) < 0.5f)
+        return;
     
-    // pass the context to filter chain for processing
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    // the buffers are being allocated or freed right now, so this block goes unanalysed
+    const juce::SpinLock::ScopedTryLockType lock(analyzerLock);
+    if (!lock.isLocked() || !analyzerTapActive.load(std::memory_order_relaxed))
+        return;
     
     leftChannelFifo.update(buffer);
-    rightChannelFifo.update(buffer);
+    
+    if (!monoLayout)
+        rightChannelFifo.update(buffer);
+}
+
+void SimpleEQAudioProcessor::addAnalyzerConsumer()
+{
+    ++analyzerConsumers;
+    updateAnalyzerTap();
+}
+
+void SimpleEQAudioProcessor::removeAnalyzerConsumer()
+{
+    jassert(analyzerConsumers.load() > 0);
+    --analyzerConsumers;
+    updateAnalyzerTap();
+}
+
+void SimpleEQAudioProcessor::updateAnalyzerTap()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    
+    const juce::SpinLock::ScopedLockType lock(analyzerLock);
+    
+    // nothing can be allocated before prepareToPlay has told us the block size
+    const auto blockSize = analyzerBlockSize.load();
+    const auto shouldBeActive = analyzerConsumers.load() > 0 && blockSize > 0;
+    
+    if (shouldBeActive && analyzerPreparedSize != blockSize)
+    {
+        leftChannelFifo.prepare(blockSize);
+        rightChannelFifo.prepare(blockSize);
+        analyzerPreparedSize = blockSize;
+    }
+    else if (!shouldBeActive && analyzerPreparedSize != 0)
+    {
+        leftChannelFifo.release();
+        rightChannelFifo.release();
+        analyzerPreparedSize = 0;
+    }
+    
+    analyzerTapActive.store(shouldBeActive, std::memory_order_release);
 }
 
 //==============================================================================
@@ -222,196 +414,1516 @@ void SimpleEQAudioProcessor::setStateInformation (const void* data, int sizeInBy
     if (tree.isValid())
     {
         apvts.replaceState(tree);
-        updateFilters();
+        parametersChanged.set(true);
+    }
+}
+
+//==============================================================================
+void SimpleEQAudioProcessor::parameterValueChanged(int parameterIndex, float newValue)
+{
+    parametersChanged.set(true);
+}
+
+int SimpleEQAudioProcessor::useTimeSlice()
+{
+    if (parametersChanged.compareAndSetBool(false, true))
+        designCoefficients();
+    
+    // these two resize the processing, which only a prepareToPlay can do
+    if (needsReprepare() && !reprepareRequested.exchange(true))
+        triggerAsyncUpdate();
+    
+    // milliseconds until the designer checks for changes again
+    return 5;
+}
+
+bool SimpleEQAudioProcessor::needsReprepare()
+{
+    const juce::ScopedLock sl(designLock);
+    
+    return designSampleRate > 0.0
+        && (juce::jlimit(0, 2, juce::roundToInt(oversamplingChoice->load())) != preparedOversamplingOrder
+            || juce::jlimit(0, 2, juce::roundToInt(linearPhaseLatency->load())) != preparedLatencyMode);
+}
+
+void SimpleEQAudioProcessor::handleAsyncUpdate()
+{
+    // "Oversampling" or "Linear Phase Latency" moved, so everything is prepared again at the
+    // host's rate and block size, with processBlock held off and the new latency reported
+    if (reprepareRequested.exchange(false) && getSampleRate() > 0.0)
+    {
+        const auto wasSuspended = isSuspended();
+        suspendProcessing(true);
+        prepareToPlay(getSampleRate(), getBlockSize());
+        suspendProcessing(wasSuspended);
+    }
+    
+    setLatencySamples(getCurrentLatencySamples());
+    updateAnalyzerTap();
+}
+
+int SimpleEQAudioProcessor::getCurrentLatencySamples() const
+{
+    // linear phase runs at the host rate, so the oversampling stages are skipped
+    if (isLinearPhase())
+        return linearPhaseLatencySamples.load();
+    
+    return oversamplerLatencySamples.load();
+}
+
+void SimpleEQAudioProcessor::processOversampled(const juce::dsp::AudioBlock<float>& block)
+{
+    if (oversampler == nullptr)
+    {
+        processCascade(block);
+        return;
     }
+    
+    auto oversampledBlock = oversampler->processSamplesUp(block);
+    processCascade(oversampledBlock);
+    
+    auto output = block;
+    oversampler->processSamplesDown(output);
+}
+
+void SimpleEQAudioProcessor::processCascade(const juce::dsp::AudioBlock<float>& block)
+{
+    if (numParameterEvents > 0)
+        processWithParameterEvents(block);
+    else
+        processSegment(block);
 }
 
 // MODIFIED by zyinmatrix
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
 {
-    ChainSettings settings;
+    return ChainParameters(apvts).load();
+}
+
+ChainParameters::ChainParameters(juce::AudioProcessorValueTreeState& apvts, const juce::String& prefix)
+{
     // low/high cut frequency and slope
-    settings.lowCutFreq = apvts.getRawParameterValue("LowCut Freq")->load();
-    settings.highCutFreq = apvts.getRawParameterValue("HighCut Freq")->load();
+    lowCutFreq = apvts.getRawParameterValue(prefix + "LowCut Freq");
+    highCutFreq = apvts.getRawParameterValue(prefix + "HighCut Freq");
+    
+    lowCutSlope = apvts.getRawParameterValue(prefix + "LowCut Slope");
+    highCutSlope = apvts.getRawParameterValue(prefix + "HighCut Slope");
+    
+    // frequency, gain, quality and bypass of every band the build can hold
+    for (int i = 0; i < maxBands; ++i)
+    {
+        const auto name = prefix + "Band" + juce::String(i + 1);
+        auto& band = bands[(size_t) i];
+        
+        band.freq = apvts.getRawParameterValue(name + " Freq");
+        band.gain = apvts.getRawParameterValue(name + " Gain");
+        band.quality = apvts.getRawParameterValue(name + " Quality");
+        band.bypassed = apvts.getRawParameterValue(name + " Bypassed");
+        
+        band.dynamic = apvts.getRawParameterValue(name + " Dynamic");
+        band.threshold = apvts.getRawParameterValue(name + " Threshold");
+        band.range = apvts.getRawParameterValue(name + " Range");
+        
+        jassert(band.freq != nullptr && band.gain != nullptr && band.quality != nullptr && band.bypassed != nullptr);
+        jassert(band.dynamic != nullptr && band.threshold != nullptr && band.range != nullptr);
+    }
+    
+    // the number of active bands and the detector times are shared by both channels
+    numBands = apvts.getRawParameterValue("Active Bands");
+    dynamicAttack = apvts.getRawParameterValue("Dynamic Attack");
+    dynamicRelease = apvts.getRawParameterValue("Dynamic Release");
+    
+    lowCutBypassed = apvts.getRawParameterValue(prefix + "LowCut Bypassed");
+    highCutBypassed = apvts.getRawParameterValue(prefix + "HighCut Bypassed");
+    
+    jassert(lowCutFreq != nullptr && highCutFreq != nullptr && lowCutSlope != nullptr && highCutSlope != nullptr);
+    jassert(numBands != nullptr && dynamicAttack != nullptr && dynamicRelease != nullptr);
+    jassert(lowCutBypassed != nullptr && highCutBypassed != nullptr);
+}
+
+ChainSettings ChainParameters::load() const
+{
+    // the values are independent of each other, so no ordering is needed
+    constexpr auto order = std::memory_order_relaxed;
     
-    settings.lowCutSlope = static_cast<Slope> (apvts.getRawParameterValue("LowCut Slope")->load());
-    settings.highCutSlope = static_cast<Slope> (apvts.getRawParameterValue("HighCut Slope")->load());
+    ChainSettings settings;
+    settings.lowCutFreq = lowCutFreq->load(order);
+    settings.highCutFreq = highCutFreq->load(order);
     
-    // band 1 frequency, gain, and quality
-    settings.band1Freq = apvts.getRawParameterValue("Band1 Freq")->load();
-    settings.band1GainInDecibles= apvts.getRawParameterValue("Band1 Gain")->load();
-    settings.band1Quality = apvts.getRawParameterValue("Band1 Quality")->load();
+    settings.lowCutSlope = static_cast<Slope> (lowCutSlope->load(order));
+    settings.highCutSlope = static_cast<Slope> (highCutSlope->load(order));
     
+    settings.numBands = juce::jlimit(1, maxBands, juce::roundToInt(numBands->load(order)));
     
-    // band 2 frequency, gain, and quality
-    settings.band2Freq = apvts.getRawParameterValue("Band2 Freq")->load();
-    settings.band2GainInDecibles= apvts.getRawParameterValue("Band2 Gain")->load();
-    settings.band2Quality = apvts.getRawParameterValue("Band2 Quality")->load();
+    for (int i = 0; i < maxBands; ++i)
+    {
+        const auto& source = bands[(size_t) i];
+        auto& band = settings.bands[(size_t) i];
+        
+        band.freq = source.freq->load(order);
+        band.gainInDecibels = source.gain->load(order);
+        band.quality = source.quality->load(order);
+        band.bypassed = source.bypassed->load(order) > 0.5f;
+        
+        band.dynamic = source.dynamic->load(order) > 0.5f;
+        band.threshold = source.threshold->load(order);
+        band.range = source.range->load(order);
+    }
     
-    // band 3 frequency, gain, and quality
-    settings.band3Freq = apvts.getRawParameterValue("Band3 Freq")->load();
-    settings.band3GainInDecibles= apvts.getRawParameterValue("Band3 Gain")->load();
-    settings.band3Quality = apvts.getRawParameterValue("Band3 Quality")->load();
+    settings.dynamicAttack = dynamicAttack->load(order);
+    settings.dynamicRelease = dynamicRelease->load(order);
     
-    settings.band1Bypassed = apvts.getRawParameterValue("Band1 Bypassed")->load()>0.5f;
-    settings.band2Bypassed = apvts.getRawParameterValue("Band2 Bypassed")->load()>0.5f;
-    settings.band3Bypassed = apvts.getRawParameterValue("Band3 Bypassed")->load()>0.5f;
-    settings.lowCutBypassed = apvts.getRawParameterValue("LowCut Bypassed")->load()>0.5f;
-    settings.highCutBypassed = apvts.getRawParameterValue("HighCut Bypassed")->load()>0.5f;
+    settings.lowCutBypassed = lowCutBypassed->load(order) > 0.5f;
+    settings.highCutBypassed = highCutBypassed->load(order) > 0.5f;
     
     return settings;
 }
 
-void SimpleEQAudioProcessor::updateFilters()
+// the first three bands keep their original defaults, the others are log spaced from 100 Hz to 12 kHz
+static float getDefaultBandFrequency(int band)
+{
+    static constexpr std::array<float, 3> firstBands { 250.f, 2500.f, 8000.f };
+    if (band < 3)
+        return firstBands[(size_t) band];
+    
+    const auto position = (float) (band - 3) / (float) juce::jmax(1, maxBands - 4);
+    return std::round(100.f * std::pow(120.f, position));
+}
+
+// returns true if the settings of a filter differ between two ChainSettings
+static bool bandChanged(const BandSettings& a, const BandSettings& b)
+{
+    return a.freq != b.freq
+        || a.gainInDecibels != b.gainInDecibels
+        || a.quality != b.quality;
+}
+
+static bool lowCutChanged(const ChainSettings& a, const ChainSettings& b)
+{
+    return a.lowCutFreq != b.lowCutFreq || a.lowCutSlope != b.lowCutSlope;
+}
+
+static bool highCutChanged(const ChainSettings& a, const ChainSettings& b)
 {
-    auto chainSettings = getChainSettings(apvts);
-    updateBandFilters(chainSettings);
-    updateLowCutFilter(chainSettings);
-    updateHighCutFilter(chainSettings);
+    return a.highCutFreq != b.highCutFreq || a.highCutSlope != b.highCutSlope;
+}
 
+StereoSettings SimpleEQAudioProcessor::getStereoSettings() const
+{
+    auto chainSettings = chainParameters.load();
     
+    // unlinked, the right channel follows the second set of parameters
+    return { chainSettings, isStereoLinked() ? chainSettings : secondChainParameters.load() };
 }
 
-Coefficients makeBand1Filter(const ChainSettings& chainSettings, double sampleRate)
+void SimpleEQAudioProcessor::designCoefficients()
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
-                                                               chainSettings.band1Freq,
-                                                               chainSettings.band1Quality,
-                                                               juce::Decibels::decibelsToGain(chainSettings.band1GainInDecibles));
+    const juce::ScopedLock sl(designLock);
+    
+    // nothing can be designed before prepareToPlay has told us the sample rate
+    if (designSampleRate <= 0.0)
+        return;
+    
+    auto stereoSettings = getStereoSettings();
+    
+    // the other engine's sections are designed differently, so switching redesigns everything
+    const auto engine = getFilterEngine();
+    if (engine != designedEngine)
+    {
+        designedEngine = engine;
+        filtersNeedFullUpdate = true;
+    }
+    
+    designChannel(stereoSettings[0], lastChainSettings[0], designedCoefficients[0]);
+    
+    // linked channels share the left channel's design
+    if (isStereoLinked())
+        designedCoefficients[1] = designedCoefficients[0];
+    else
+        designChannel(stereoSettings[1], lastChainSettings[1], designedCoefficients[1]);
+    
+    lastChainSettings = stereoSettings;
+    filtersNeedFullUpdate = false;
+    
+    coefficientMailbox.getWriteSlot() = designedCoefficients;
+    coefficientMailbox.publish();
+    
+    // the cascade rings at the oversampled rate, silence is counted at the host rate
+    auto tailLength = juce::jmax(getTailLengthInSamples(designedCoefficients[0], stereoSettings[0]),
+                                 getTailLengthInSamples(designedCoefficients[1], stereoSettings[1]));
+    tailLength = (tailLength + oversamplingFactor - 1) / oversamplingFactor + oversamplerTailSamples;
+    
+    const auto linear = isLinearPhase();
+    if (linear)
+    {
+        loadLinearPhaseKernels(stereoSettings);
+        tailLength = juce::jmax(tailLength, kernelLength + linearPhaseLatencySamples.load());
+    }
+    
+    // switching modes changes the latency, which the host has to hear about on the message thread
+    if (linear != lastLinearPhase)
+    {
+        lastLinearPhase = linear;
+        triggerAsyncUpdate();
+    }
+    
+    tailLengthSamples.store(tailLength);
 }
 
-Coefficients makeBand2Filter(const ChainSettings& chainSettings, double sampleRate)
+void SimpleEQAudioProcessor::designChannel(const ChainSettings &chainSettings, const ChainSettings &lastSettings, ChainCoefficients &coefficients)
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
-                                                               chainSettings.band2Freq,
-                                                               chainSettings.band2Quality,
-                                                               juce::Decibels::decibelsToGain(chainSettings.band2GainInDecibles));
+    // the SVF designs are cheap enough to simply redo them all
+    if (designedEngine == FilterEngine::svf)
+    {
+        makeSVFCoefficients(coefficients, chainSettings, designSampleRate);
+        return;
+    }
+    
+    coefficients.engine = FilterEngine::biquad;
+    
+    // only redesign the filters whose frequency, gain, quality or slope moved
+    for (int i = 0; i < maxBands; ++i)
+    {
+        const auto& band = chainSettings.bands[(size_t) i];
+        if (filtersNeedFullUpdate || bandChanged(band, lastSettings.bands[(size_t) i]))
+        {
+            const auto shape = makePeakShape(designSampleRate, band.freq, band.quality, band.gainInDecibels);
+            coefficients.peakShapes[(size_t) i] = shape;
+            coefficients.bands[(size_t) i] = makePeakCoefficients(shape, band.gainInDecibels);
+        }
+    }
+    
+    if (filtersNeedFullUpdate || lowCutChanged(chainSettings, lastSettings))
+    {
+        coefficients.lowCut = makeLowCutCoefficients(chainSettings, designSampleRate);
+        coefficients.lowCutSlope = chainSettings.lowCutSlope;
+    }
+    
+    if (filtersNeedFullUpdate || highCutChanged(chainSettings, lastSettings))
+    {
+        coefficients.highCut = makeHighCutCoefficients(chainSettings, designSampleRate);
+        coefficients.highCutSlope = chainSettings.highCutSlope;
+    }
 }
 
-Coefficients makeBand3Filter(const ChainSettings& chainSettings, double sampleRate)
+//==============================================================================
+// magnitude of one section at the angular frequency w, in radians per sample
+static double getSectionMagnitude(const BiquadCoefficients& c, double w)
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
-                                                               chainSettings.band3Freq,
-                                                               chainSettings.band3Quality,
-                                                               juce::Decibels::decibelsToGain(chainSettings.band3GainInDecibles));
+    const auto z1 = std::polar(1.0, -w);
+    const auto z2 = z1 * z1;
+    
+    const auto numerator = (double) c.b0 + (double) c.b1 * z1 + (double) c.b2 * z2;
+    const auto denominator = 1.0 + (double) c.a1 * z1 + (double) c.a2 * z2;
+    return std::abs(numerator) / std::abs(denominator);
 }
 
+// magnitude of the enabled part of a chain, the same response the editor draws
+static double getChainMagnitude(const ChainCoefficients& c, const ChainSettings& chainSettings, double w)
+{
+    auto magnitude = 1.0;
+    
+    if (!chainSettings.lowCutBypassed)
+        for (int i = 0; i <= c.lowCutSlope; ++i)
+            magnitude *= getSectionMagnitude(c.lowCut[i], w);
+    
+    for (int i = 0; i < chainSettings.numBands; ++i)
+        if (!chainSettings.bands[(size_t) i].bypassed)
+            magnitude *= getSectionMagnitude(c.bands[(size_t) i], w);
+    
+    if (!chainSettings.highCutBypassed)
+        for (int i = 0; i <= c.highCutSlope; ++i)
+            magnitude *= getSectionMagnitude(c.highCut[i], w);
+    
+    return magnitude;
+}
 
-void /*SimpleEQAudioProcessor::*/updateCoefficients(Coefficients &old, const Coefficients &replacements)
+double getMagnitudeForFrequency(const ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings,
+                                double frequency, double sampleRate)
 {
-    *old = *replacements;
+    return getChainMagnitude(chainCoefficients, chainSettings, juce::MathConstants<double>::twoPi * frequency / sampleRate);
 }
 
+/*
+ fills kernel with fft.getSize() - 1 taps of a linear phase FIR with the chain's magnitude
+ response. The zero phase spectrum is delayed by half the FFT size, so the impulse response
+ comes out symmetric around tap fft.getSize() / 2 - 1, and is then windowed.
+ */
+static void makeLinearPhaseKernel(float* kernel, juce::dsp::FFT& fft, std::vector<float>& spectrum,
+                                  juce::dsp::WindowingFunction<float>& window, int oversamplingFactor,
+                                  const ChainCoefficients& c, const ChainSettings& chainSettings)
+{
+    const auto size = fft.getSize();
+    std::fill(spectrum.begin(), spectrum.end(), 0.f);
+    
+    for (int k = 0; k <= size / 2; ++k)
+    {
+        // coefficients designed for an oversampled rate are read off below their own Nyquist
+        const auto w = juce::MathConstants<double>::twoPi * k / (size * oversamplingFactor);
+        spectrum[(size_t) (2 * k)] = (float) ((k % 2 == 0 ? 1.0 : -1.0) * getChainMagnitude(c, chainSettings, w));
+    }
+    
+    fft.performRealOnlyInverseTransform(spectrum.data());
+    
+    // the first tap has no partner on the other side of the centre
+    std::copy(spectrum.begin() + 1, spectrum.begin() + size, kernel);
+    window.multiplyWithWindowingTable(kernel, (size_t) (size - 1));
+}
 
-void SimpleEQAudioProcessor::updateBandFilters(const ChainSettings &chainSettings)
+void SimpleEQAudioProcessor::prepareLinearPhase(double sampleRate, int samplesPerBlock)
 {
-    // calculate peak filters' coefficients
-    auto band1Coefficients = makeBand1Filter(chainSettings, getSampleRate());
+    // FFT size and partition latency for low, medium and high latency. Longer kernels resolve
+    // the low end better, larger partitions cost less CPU, the lowest uses the host block size
+    static constexpr std::array<int, 3> fftSizes { 2048, 8192, 16384 };
+    static constexpr std::array<int, 3> partitionLatencies { 0, 1024, 4096 };
+    
+    const auto mode = juce::jlimit(0, 2, juce::roundToInt(linearPhaseLatency->load()));
+    preparedLatencyMode = mode;
+    kernelLength = fftSizes[(size_t) mode] - 1;
     
-    auto band2Coefficients = makeBand2Filter(chainSettings, getSampleRate());
+    convolutions.clear();
+    
+    for (int first = 0; first < juce::jmax(1, numChannels); first += 2)
+    {
+        auto convolution = std::make_unique<juce::dsp::Convolution>(juce::dsp::Convolution::Latency { partitionLatencies[(size_t) mode] });
+        convolution->prepare({ sampleRate, (juce::uint32) samplesPerBlock, (juce::uint32) juce::jlimit(1, 2, numChannels - first) });
+        convolutions.push_back(std::move(convolution));
+    }
+    
+    linearPhaseLatencySamples = fftSizes[(size_t) mode] / 2 - 1 + convolutions.front()->getLatency();
+}
 
-    auto band3Coefficients = makeBand3Filter(chainSettings, getSampleRate());
+void SimpleEQAudioProcessor::loadLinearPhaseKernels(const StereoSettings &stereoSettings)
+{
+    const auto size = kernelLength + 1;
+    juce::dsp::FFT fft(juce::roundToInt(std::log2(size)));
+    std::vector<float> spectrum((size_t) (2 * size));
+    juce::dsp::WindowingFunction<float> window((size_t) kernelLength, juce::dsp::WindowingFunction<float>::blackman, false);
     
-    // set peak filter's coefficients
-    updateCoefficients(leftChain.get<ChainPositions::Band1>().coefficients, band1Coefficients);
-    updateCoefficients(rightChain.get<ChainPositions::Band1>().coefficients, band1Coefficients);
+    // only stereo can be unlinked, wider layouts share the left channel's kernel
+    juce::AudioBuffer<float> kernels(numChannels == 1 ? 1 : 2, kernelLength);
+    makeLinearPhaseKernel(kernels.getWritePointer(0), fft, spectrum, window, oversamplingFactor, designedCoefficients[0], stereoSettings[0]);
     
-    updateCoefficients(leftChain.get<ChainPositions::Band2>().coefficients, band2Coefficients);
-    updateCoefficients(rightChain.get<ChainPositions::Band2>().coefficients, band2Coefficients);
+    if (kernels.getNumChannels() == 2)
+    {
+        if (numChannels == 2)
+            makeLinearPhaseKernel(kernels.getWritePointer(1), fft, spectrum, window, oversamplingFactor, designedCoefficients[1], stereoSettings[1]);
+        else
+            kernels.copyFrom(1, 0, kernels, 0, 0, kernelLength);
+    }
     
-    updateCoefficients(leftChain.get<ChainPositions::Band3>().coefficients, band3Coefficients);
-    updateCoefficients(rightChain.get<ChainPositions::Band3>().coefficients, band3Coefficients);
+    // the convolutions swap to the new kernels in the background and crossfade to them
+    for (size_t pair = 0; pair < convolutions.size(); ++pair)
+    {
+        // a lone last channel gets a mono kernel
+        const auto numPairChannels = juce::jlimit(1, 2, numChannels - 2 * (int) pair);
+        const auto stereo = numPairChannels == 2 ? juce::dsp::Convolution::Stereo::yes : juce::dsp::Convolution::Stereo::no;
+        
+        juce::AudioBuffer<float> kernel(numPairChannels, kernelLength);
+        for (int ch = 0; ch < numPairChannels; ++ch)
+            kernel.copyFrom(ch, 0, kernels, ch, 0, kernelLength);
+        
+        convolutions[pair]->loadImpulseResponse(std::move(kernel), designSampleRate / oversamplingFactor, stereo,
+                                                juce::dsp::Convolution::Trim::no, juce::dsp::Convolution::Normalise::no);
+    }
+}
+
+// in place, the halves keep mid and side at the level of the left and right channels
+static void encodeMidSide(float* left, float* right, int numSamples)
+{
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const auto mid = 0.5f * (left[i] + right[i]);
+        const auto side = 0.5f * (left[i] - right[i]);
+        left[i] = mid;
+        right[i] = side;
+    }
+}
+
+static void decodeMidSide(float* mid, float* side, int numSamples)
+{
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const auto left = mid[i] + side[i];
+        const auto right = mid[i] - side[i];
+        mid[i] = left;
+        side[i] = right;
+    }
+}
+
+void SimpleEQAudioProcessor::processLinearPhase(const juce::dsp::AudioBlock<float>& block)
+{
+    // the convolution runs in place, so mid/side needs passes of its own here
+    const auto midSideChannels = isMidSide();
+    const auto numSamples = (int) block.getNumSamples();
     
-    // update bypass states
-    leftChain.setBypassed<ChainPositions::Band1>(chainSettings.band1Bypassed);
-    rightChain.setBypassed<ChainPositions::Band1>(chainSettings.band1Bypassed);
+    if (midSideChannels)
+        encodeMidSide(block.getChannelPointer(0), block.getChannelPointer(1), numSamples);
     
-    leftChain.setBypassed<ChainPositions::Band2>(chainSettings.band2Bypassed);
-    rightChain.setBypassed<ChainPositions::Band2>(chainSettings.band2Bypassed);
+    for (size_t pair = 0; pair < convolutions.size(); ++pair)
+    {
+        const auto first = 2 * pair;
+        auto channels = block.getSubsetChannelBlock(first, juce::jmin((size_t) 2, block.getNumChannels() - first));
+        
+        juce::dsp::ProcessContextReplacing<float> context(channels);
+        convolutions[pair]->process(context);
+    }
     
-    leftChain.setBypassed<ChainPositions::Band3>(chainSettings.band3Bypassed);
-    rightChain.setBypassed<ChainPositions::Band3>(chainSettings.band3Bypassed);
+    if (midSideChannels)
+        decodeMidSide(block.getChannelPointer(0), block.getChannelPointer(1), numSamples);
 }
 
+// number of samples it takes a section's impulse response to decay below the silence threshold
+int getDecayLengthInSamples(const BiquadCoefficients& coefficients)
+{
+    // the poles are the roots of z^2 + a1 z + a2
+    auto a1 = (double) coefficients.a1;
+    auto a2 = (double) coefficients.a2;
+    auto discriminant = a1 * a1 - 4.0 * a2;
+    
+    double poleRadius;
+    if (discriminant < 0.0)
+    {
+        poleRadius = std::sqrt(a2);
+    }
+    else
+    {
+        auto root = std::sqrt(discriminant);
+        poleRadius = juce::jmax(std::abs(-a1 + root), std::abs(-a1 - root)) * 0.5;
+    }
+    
+    // the numerator adds up to two more samples of ringing
+    if (poleRadius <= 0.0)
+        return 2;
+    
+    // an unstable or extremely resonant section never really decays, so cap it
+    constexpr int maximumDecayLength = 1 << 20;
+    if (poleRadius >= 1.0)
+        return maximumDecayLength;
+    
+    auto decay = std::log((double) SimpleEQAudioProcessor::silenceThreshold) / std::log(poleRadius);
+    return juce::jmin(maximumDecayLength, 2 + (int) std::ceil(decay));
+}
 
+int getTailLengthInSamples(const ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings)
+{
+    // the sections ring one after another, so adding their decays up gives a safe upper bound
+    int tail = 0;
+    
+    if (!chainSettings.lowCutBypassed)
+        for (int i = 0; i <= chainCoefficients.lowCutSlope; ++i)
+            tail += getDecayLengthInSamples(chainCoefficients.lowCut[i]);
+    
+    for (int i = 0; i < chainSettings.numBands; ++i)
+    {
+        const auto& band = chainSettings.bands[(size_t) i];
+        if (band.bypassed)
+            continue;
+        
+        // a dynamic band rings longest at the top of its boost
+        if (band.dynamic && band.range > 0.f)
+        {
+            const auto& shape = chainCoefficients.peakShapes[(size_t) i];
+            tail += getDecayLengthInSamples(makePeakCoefficients(shape, shape.gainInDecibels + band.range));
+        }
+        else
+        {
+            tail += getDecayLengthInSamples(chainCoefficients.bands[(size_t) i]);
+        }
+    }
+    
+    if (!chainSettings.highCutBypassed)
+        for (int i = 0; i <= chainCoefficients.highCutSlope; ++i)
+            tail += getDecayLengthInSamples(chainCoefficients.highCut[i]);
+    
+    return tail;
+}
 
-void SimpleEQAudioProcessor::updateLowCutFilter(const ChainSettings &chainSettings)
+PeakShape makePeakShape(double sampleRate, float frequency, float quality, float gainInDecibels)
 {
-    // calculate cut filters' coefficients
-    auto lowCutCoefficients = makeLowCutFilter( chainSettings, getSampleRate());
-    // update low cut filter chains
-    auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-    updateCutFilter(leftLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
+    const auto omega = (juce::MathConstants<double>::twoPi * frequency) / sampleRate;
+    return { (float) (std::sin(omega) / (quality * 2.0)), (float) (-2.0 * std::cos(omega)),
+             (float) std::tan(omega / 2.0), 1.f / quality, gainInDecibels };
+}
 
-    auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
-    updateCutFilter(rightLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
+BiquadCoefficients makePeakCoefficients(const PeakShape& shape, float gainInDecibels)
+{
+    // same formulas as juce::dsp::IIR::Coefficients::makePeakFilter
+    const auto A = std::pow(10.f, gainInDecibels / 40.f);
+    const auto alphaTimesA = shape.alpha * A;
+    const auto alphaOverA = shape.alpha / A;
+    const auto a0 = 1.f / (1.f + alphaOverA);
     
-    // update bypass states
-    leftChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    rightChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+    return { (1.f + alphaTimesA) * a0, shape.c2 * a0, (1.f - alphaTimesA) * a0,
+             shape.c2 * a0, (1.f - alphaOverA) * a0 };
+}
+
+SVFCoefficients makeSVFPeakCoefficients(const PeakShape& shape, float gainInDecibels)
+{
+    // a bell with the same response as makePeakFilter
+    const auto a = std::pow(10.f, gainInDecibels / 40.f);
+    const auto k = shape.inverseQ / a;
+    return { shape.g, k, 1.f, k * (a * a - 1.f), 0.f };
 }
 
-void SimpleEQAudioProcessor::updateHighCutFilter(const ChainSettings &chainSettings)
+BiquadCoefficients makePeakCoefficients(double sampleRate, float frequency, float quality, float gainInDecibels)
 {
-    // calculate cut filters' coefficients
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
-    // update high cut filter chains
-    auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-    updateCutFilter(leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    return makePeakCoefficients(makePeakShape(sampleRate, frequency, quality, gainInDecibels), gainInDecibels);
+}
+
+// the Q of each second order stage of an even order Butterworth filter
+static double getButterworthQuality(int stage, int order)
+{
+    return 1.0 / (2.0 * std::cos((2.0 * stage + 1.0) * juce::MathConstants<double>::pi / (order * 2.0)));
+}
 
-    auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
-    updateCutFilter(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+std::array<BiquadCoefficients, 4> makeLowCutCoefficients(const ChainSettings& chainSettings, double sampleRate)
+{
+    // same formulas as juce::dsp::IIR::Coefficients::makeHighPass
+    const auto order = 2 * (chainSettings.lowCutSlope + 1);
+    const auto n = std::tan(juce::MathConstants<double>::pi * chainSettings.lowCutFreq / sampleRate);
+    const auto nSquared = n * n;
+    
+    std::array<BiquadCoefficients, 4> stages;
+    for (int i = 0; i < order / 2; ++i)
+    {
+        const auto invQ = 1.0 / getButterworthQuality(i, order);
+        const auto c1 = 1.0 / (1.0 + invQ * n + nSquared);
+        stages[i] = { (float) c1, (float) (c1 * -2.0), (float) c1,
+                      (float) (c1 * 2.0 * (nSquared - 1.0)), (float) (c1 * (1.0 - invQ * n + nSquared)) };
+    }
     
-    // update bypass states
-    leftChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    rightChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    return stages;
 }
 
-juce::AudioProcessorValueTreeState::ParameterLayout
-SimpleEQAudioProcessor::createParameterLayout()
+std::array<BiquadCoefficients, 4> makeHighCutCoefficients(const ChainSettings& chainSettings, double sampleRate)
 {
-    // use AudioParameterFloat type for the parameters
-//    std::vector<std::unique_ptr<juce::RangedAudioParameter>> params;
-    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    // same formulas as juce::dsp::IIR::Coefficients::makeLowPass
+    const auto order = 2 * (chainSettings.highCutSlope + 1);
+    const auto n = 1.0 / std::tan(juce::MathConstants<double>::pi * chainSettings.highCutFreq / sampleRate);
+    const auto nSquared = n * n;
     
-    // low cut, high cut frequency
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("LowCut Freq", 1), "LowCut Freq", juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), 20.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("HighCut Freq", 1), "HighCut Freq", juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), 20000.f));
+    std::array<BiquadCoefficients, 4> stages;
+    for (int i = 0; i < order / 2; ++i)
+    {
+        const auto invQ = 1.0 / getButterworthQuality(i, order);
+        const auto c1 = 1.0 / (1.0 + invQ * n + nSquared);
+        stages[i] = { (float) c1, (float) (c1 * 2.0), (float) c1,
+                      (float) (c1 * 2.0 * (1.0 - nSquared)), (float) (c1 * (1.0 - invQ * n + nSquared)) };
+    }
     
-    // band filter 1 frequency, gain, and quality
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Band1 Freq", 1), "Band1 Freq", juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), 250.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Band1 Gain", 1), "Band1 Gain", juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f), 0.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Band1 Quality", 1), "Band1 Quality", juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f), 1.f));
+    return stages;
+}
+
+ChainCoefficients makeChainCoefficients(const ChainSettings& chainSettings, double sampleRate, FilterEngine engine)
+{
+    ChainCoefficients chainCoefficients;
     
-    // band filter 2 frequency, gain, and quality
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Band2 Freq", 1), "Band2 Freq", juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), 2500.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Band2 Gain", 1), "Band2 Gain", juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f), 0.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Band2 Quality", 1), "Band2 Quality", juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f), 1.f));
+    if (engine == FilterEngine::svf)
+    {
+        makeSVFCoefficients(chainCoefficients, chainSettings, sampleRate);
+        return chainCoefficients;
+    }
     
-    // band filter 3 frequency, gain, and quality
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Band3 Freq", 1), "Band3 Freq", juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), 8000.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Band3 Gain", 1), "Band3 Gain", juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f), 0.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Band3 Quality", 1), "Band3 Quality", juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f), 1.f));
+    for (int i = 0; i < maxBands; ++i)
+    {
+        const auto& band = chainSettings.bands[(size_t) i];
+        chainCoefficients.peakShapes[(size_t) i] = makePeakShape(sampleRate, band.freq, band.quality, band.gainInDecibels);
+        chainCoefficients.bands[(size_t) i] = makePeakCoefficients(chainCoefficients.peakShapes[(size_t) i], band.gainInDecibels);
+    }
+    chainCoefficients.lowCut = makeLowCutCoefficients(chainSettings, sampleRate);
+    chainCoefficients.highCut = makeHighCutCoefficients(chainSettings, sampleRate);
+    chainCoefficients.lowCutSlope = chainSettings.lowCutSlope;
+    chainCoefficients.highCutSlope = chainSettings.highCutSlope;
+    return chainCoefficients;
+}
+
+// Butterworth stages sharing one g, the high pass output is x - k * band - low
+static std::array<SVFCoefficients, 4> makeSVFCut(double sampleRate, float frequency, Slope slope, bool highPass)
+{
+    const auto order = 2 * (slope + 1);
+    const auto g = (float) std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
     
-    // string array for slope
-    juce::StringArray slopeArray;
-    for (int i = 0; i<4; ++i){
-        juce::String str;
-        str << (12 + i*12);
-        str << " db/Oct";
-        slopeArray.add(str);
+    std::array<SVFCoefficients, 4> stages;
+    for (int i = 0; i < order / 2; ++i)
+    {
+        const auto k = (float) (1.0 / getButterworthQuality(i, order));
+        stages[i] = highPass ? SVFCoefficients { g, k, 1.f, -k, -1.f } : SVFCoefficients { g, k, 0.f, 0.f, 1.f };
     }
     
-    // low cut, high cut slopes
-    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("LowCut Slope", 1), "LowCut Slope", slopeArray, 0));
-    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("HighCut Slope", 1), "HighCut Slope", slopeArray, 0));
+    return stages;
+}
+
+void makeSVFCoefficients(ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings, double sampleRate)
+{
+    auto& c = chainCoefficients;
+    for (int i = 0; i < maxBands; ++i)
+    {
+        const auto& band = chainSettings.bands[(size_t) i];
+        c.peakShapes[(size_t) i] = makePeakShape(sampleRate, band.freq, band.quality, band.gainInDecibels);
+        c.svfBands[(size_t) i] = makeSVFPeakCoefficients(c.peakShapes[(size_t) i], band.gainInDecibels);
+    }
+    c.svfLowCut = makeSVFCut(sampleRate, chainSettings.lowCutFreq, chainSettings.lowCutSlope, true);
+    c.svfHighCut = makeSVFCut(sampleRate, chainSettings.highCutFreq, chainSettings.highCutSlope, false);
+    
+    // the equivalent biquads, for the tail length and the linear phase kernels
+    for (int i = 0; i < 4; ++i)
+    {
+        c.lowCut[i] = toBiquadCoefficients(c.svfLowCut[i]);
+        c.highCut[i] = toBiquadCoefficients(c.svfHighCut[i]);
+    }
+    
+    for (int i = 0; i < maxBands; ++i)
+        c.bands[(size_t) i] = toBiquadCoefficients(c.svfBands[(size_t) i]);
+    
+    c.lowCutSlope = chainSettings.lowCutSlope;
+    c.highCutSlope = chainSettings.highCutSlope;
+    c.engine = FilterEngine::svf;
+}
+
+BiquadCoefficients toBiquadCoefficients(const SVFCoefficients& c)
+{
+    // the bilinear transform of the SVF's analog prototype, normalised by a0
+    const auto g = (double) c.g, k = (double) c.k, gSquared = g * g;
+    const auto a0 = 1.0 + g * k + gSquared;
+    const auto a2 = 1.0 - g * k + gSquared;
+    
+    return { (float) ((c.m0 * a0 + c.m1 * g + c.m2 * gSquared) / a0),
+             (float) ((c.m0 * (2.0 * gSquared - 2.0) + 2.0 * c.m2 * gSquared) / a0),
+             (float) ((c.m0 * a2 - c.m1 * g + c.m2 * gSquared) / a0),
+             (float) ((2.0 * gSquared - 2.0) / a0),
+             (float) (a2 / a0) };
+}
+
+void SimpleEQAudioProcessor::applyCoefficients(const StereoCoefficients &stereoCoefficients, int numSteps)
+{
+    if (monoLayout)
+    {
+        leftChain.setCoefficients(stereoCoefficients[0], numSteps);
+        return;
+    }
+    
+    // only stereo can be unlinked, wider layouts share one set of coefficients
+    channelChains.setCoefficients(stereoCoefficients[0], stereoCoefficients[numChannels == 2 ? 1 : 0], numSteps);
+}
+
+bool SimpleEQAudioProcessor::isSmoothing() const
+{
+    return monoLayout ? leftChain.isSmoothing() : channelChains.isSmoothing();
+}
+
+void SimpleEQAudioProcessor::advanceSmoothing()
+{
+    if (monoLayout)
+        leftChain.advanceSmoothing();
+    else
+        channelChains.advanceSmoothing();
+}
+
+bool SimpleEQAudioProcessor::isPassThrough() const
+{
+    // linear phase and oversampling delay the signal, so they have to run even when flat
+    if (isLinearPhase() || oversampler != nullptr || numParameterEvents > 0 || isSmoothing())
+        return false;
+    
+    return monoLayout ? leftChain.isIdentity() : channelChains.isIdentity();
+}
+
+void SimpleEQAudioProcessor::processSegment(const juce::dsp::AudioBlock<float>& block, size_t detectionStart)
+{
+    const auto numSamples = block.getNumSamples();
+    
+    if (!isSmoothing() && !dynamicBandsActive)
+    {
+        processFilters(block);
+        
+        // the grid keeps its phase, so a glide starting later is stepped at the same points
+        samplesUntilRefresh = (samplesUntilRefresh + controlBlockSize - (int) (numSamples % controlBlockSize)) % controlBlockSize;
+        return;
+    }
+    
+    // refresh the gliding coefficients and the dynamic gains whenever the grid reaches a control
+    // block boundary, wherever that falls in this block. The detectors hear every sample right
+    // before it is filtered
+    for (size_t start = 0; start < numSamples;)
+    {
+        const auto refresh = samplesUntilRefresh == 0;
+        if (refresh)
+        {
+            advanceSmoothing();
+            samplesUntilRefresh = controlBlockSize;
+        }
+        
+        const auto length = juce::jmin(numSamples - start, (size_t) samplesUntilRefresh);
+        
+        if (dynamicBandsActive)
+        {
+            detectDynamics(detectionStart + start, length);
+            
+            if (refresh)
+                applyDynamicGains();
+        }
+        
+        processFilters(block.getSubBlock(start, length));
+        
+        samplesUntilRefresh -= (int) length;
+        start += length;
+    }
+}
+
+bool SimpleEQAudioProcessor::addParameterEvent(int sampleOffset, const ChainSettings& chainSettings, int settingsIndex)
+{
+    jassert(settingsIndex == 0 || settingsIndex == 1);
+    
+    if (numParameterEvents == maxParameterEvents)
+        return false;
+    
+    // keep the queue sorted, events usually arrive in order so this rarely moves anything
+    int index = numParameterEvents++;
+    for (; index > 0 && parameterEvents[index - 1].sampleOffset > sampleOffset; --index)
+        parameterEvents[index] = parameterEvents[index - 1];
+    
+    parameterEvents[index] = { sampleOffset, juce::jlimit(0, 1, settingsIndex), chainSettings };
+    return true;
+}
+
+void SimpleEQAudioProcessor::processWithParameterEvents(const juce::dsp::AudioBlock<float>& block)
+{
+    const auto numSamples = block.getNumSamples();
+    size_t start = 0;
+    
+    // the events change one set at a time, on top of what is in force right now
+    if (!eventSettingsActive)
+    {
+        eventSettings = getStereoSettings();
+        eventCoefficients = coefficientMailbox.getReadSlot();
+        eventSettingsActive = true;
+    }
+    
+    // mono, linked and wider layouts run every channel from the main set
+    const auto followsMainSet = numChannels != 2 || isStereoLinked();
+    
+    for (int e = 0; e < numParameterEvents; ++e)
+    {
+        const auto& event = parameterEvents[e];
+        
+        // offsets are in host samples, the block may be oversampled
+        auto offset = (size_t) juce::jlimit(0, (int) numSamples, event.sampleOffset * oversamplingFactor);
+        
+        if (offset > start && !sleeping)
+            processSegment(block.getSubBlock(start, offset - start), start);
+        
+        start = juce::jmax(start, offset);
+        
+        if (event.settingsIndex == 1 && followsMainSet)
+            continue;
+        
+        // designed right here, so the change lands on exactly this sample
+        const auto index = (size_t) event.settingsIndex;
+        eventCoefficients[index] = makeChainCoefficients(event.settings, getSampleRate() * oversamplingFactor, getFilterEngine());
+        eventSettings[index] = event.settings;
+        
+        if (index == 0 && followsMainSet)
+        {
+            eventCoefficients[1] = eventCoefficients[0];
+            eventSettings[1] = event.settings;
+        }
+        
+        applyCoefficients(eventCoefficients, 0);
+        updateBypassStates(eventSettings);
+    }
+    
+    if (start < numSamples && !sleeping)
+        processSegment(block.getSubBlock(start, numSamples - start), start);
+    
+    numParameterEvents = 0;
+}
+
+void SimpleEQAudioProcessor::processFilters(const juce::dsp::AudioBlock<float>& block)
+{
+    if (monoLayout)
+    {
+        // a single scalar cascade, no interleaving and no empty lanes
+        if (!leftChain.isIdentity())
+            leftChain.process(block.getChannelPointer(0), (int) block.getNumSamples());
+        return;
+    }
+    
+    channelChains.process(block);
+}
+
+void SimpleEQAudioProcessor::resetFilters()
+{
+    leftChain.reset();
+    channelChains.reset();
+    
+    for (auto& detector : detectors)
+        detector.reset();
+    
+    for (auto& convolution : convolutions)
+        convolution->reset();
+    
+    if (oversampler != nullptr)
+        oversampler->reset();
+}
+
+void SimpleEQAudioProcessor::updateBypassStates(const StereoSettings &stereoSettings)
+{
+    if (monoLayout)
+    {
+        leftChain.setBypassStates(stereoSettings[0]);
+        return;
+    }
+    
+    channelChains.setBypassStates(stereoSettings[0], stereoSettings[numChannels == 2 ? 1 : 0]);
+}
+
+void SimpleEQAudioProcessor::prepareDetection(juce::AudioBuffer<float>& buffer, const StereoSettings &stereoSettings)
+{
+    // linked channels, and layouts other than stereo, follow the first detector
+    separateDetectors = !monoLayout && numChannels == 2 && !isStereoLinked();
+    
+    detectors[0].setSettings(stereoSettings[0]);
+    if (separateDetectors)
+        detectors[1].setSettings(stereoSettings[1]);
+    
+    dynamicBandsActive = !isLinearPhase() && (detectors[0].isActive() || (separateDetectors && detectors[1].isActive()));
+    if (!dynamicBandsActive)
+        return;
+    
+    // the sidechain keys the detectors when it is switched on and connected, the input otherwise
+    const auto useSidechain = dynamicSidechain->load(std::memory_order_relaxed) > 0.5f
+                           && getBusCount(true) > 1 && getChannelCountOfBus(true, 1) > 0;
+    const auto source = getBusBuffer(buffer, true, useSidechain ? 1 : 0);
+    
+    const auto numSamples = juce::jmin(source.getNumSamples(), detectionBuffer.getNumSamples());
+    const auto numSourceChannels = source.getNumChannels();
+    
+    if (numSourceChannels == 0)
+    {
+        dynamicBandsActive = false;
+        return;
+    }
+    
+    if (separateDetectors)
+    {
+        // a mono sidechain keys both channels
+        for (int channel = 0; channel < 2; ++channel)
+            detectionBuffer.copyFrom(channel, 0, source, juce::jmin(channel, numSourceChannels - 1), 0, numSamples);
+        
+        // mid and side bands listen to mid and side
+        if (isMidSide() && numSourceChannels > 1)
+            encodeMidSide(detectionBuffer.getWritePointer(0), detectionBuffer.getWritePointer(1), numSamples);
+    }
+    else
+    {
+        // a shared detector hears the average of all channels
+        detectionBuffer.clear(0, 0, numSamples);
+        for (int channel = 0; channel < numSourceChannels; ++channel)
+            detectionBuffer.addFrom(0, 0, source, channel, 0, numSamples, 1.f / (float) numSourceChannels);
+    }
+}
+
+void SimpleEQAudioProcessor::detectDynamics(size_t start, size_t length)
+{
+    // the detectors run at the host rate, so the range is mapped back to host samples
+    const auto end = juce::jmin((int) ((start + length) / (size_t) oversamplingFactor), detectionBuffer.getNumSamples());
+    const auto begin = juce::jmin((int) (start / (size_t) oversamplingFactor), end);
+    
+    detectors[0].process(detectionBuffer.getReadPointer(0) + begin, end - begin);
+    
+    if (separateDetectors)
+        detectors[1].process(detectionBuffer.getReadPointer(1) + begin, end - begin);
+}
+
+void SimpleEQAudioProcessor::applyDynamicGains()
+{
+    const auto& left = detectors[0].getGainOffsets();
+    
+    if (monoLayout)
+        leftChain.setDynamicGains(left);
+    else
+        channelChains.setDynamicGains(left, separateDetectors ? detectors[1].getGainOffsets() : left);
+}
+
+//==============================================================================
+void DynamicBandDetector::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    needsDesign = true;
+    reset();
+}
+
+void DynamicBandDetector::reset()
+{
+    ic1.fill(0.f);
+    ic2.fill(0.f);
+    envelope.fill(0.f);
+    gainOffsets.fill(0.f);
+}
+
+void DynamicBandDetector::setSettings(const ChainSettings& chainSettings)
+{
+    auto changed = needsDesign
+                || chainSettings.dynamicAttack != lastSettings.dynamicAttack
+                || chainSettings.dynamicRelease != lastSettings.dynamicRelease;
+    
+    for (int i = 0; i < maxBands && !changed; ++i)
+    {
+        const auto& band = chainSettings.bands[(size_t) i];
+        const auto& last = lastSettings.bands[(size_t) i];
+        const auto enabled = i < chainSettings.numBands && !band.bypassed && band.dynamic;
+        const auto wasEnabled = i < lastSettings.numBands && !last.bypassed && last.dynamic;
+        
+        changed = enabled != wasEnabled
+               || (enabled && (band.freq != last.freq || band.quality != last.quality
+                               || band.threshold != last.threshold || band.range != last.range));
+    }
+    
+    if (!changed)
+        return;
+    
+    lastSettings = chainSettings;
+    needsDesign = false;
+    active = false;
+    
+    // one pole smoothing coefficients for the envelope's attack and release
+    auto getCoefficient = [this](float milliseconds)
+    {
+        return 1.f - (float) std::exp(-1.0 / (juce::jmax(0.01, (double) milliseconds) * 0.001 * sampleRate));
+    };
+    
+    attack = getCoefficient(chainSettings.dynamicAttack);
+    release = getCoefficient(chainSettings.dynamicRelease);
+    
+    for (int i = 0; i < maxBands; ++i)
+    {
+        const auto& band = chainSettings.bands[(size_t) i];
+        const auto enabled = i < chainSettings.numBands && !band.bypassed && band.dynamic;
+        active = active || enabled;
+        
+        // a band that isn't dynamic gets a silent detector and no range, so it never moves
+        const auto g = enabled ? std::tan(juce::MathConstants<double>::pi * juce::jmin((double) band.freq, 0.49 * sampleRate) / sampleRate) : 0.0;
+        const auto bandK = enabled ? 1.0 / band.quality : 0.0;
+        const auto bandA1 = enabled ? 1.0 / (1.0 + g * (g + bandK)) : 0.0;
+        
+        a1[(size_t) i] = (float) bandA1;
+        a2[(size_t) i] = (float) (g * bandA1);
+        a3[(size_t) i] = (float) (g * g * bandA1);
+        k[(size_t) i] = (float) bandK;
+        threshold[(size_t) i] = band.threshold;
+        range[(size_t) i] = enabled ? band.range : 0.f;
+    }
+}
+
+void DynamicBandDetector::process(const float* input, int numSamples)
+{
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const auto x = input[i];
+        
+        // the bands don't depend on each other, so this loop runs across the vector lanes
+        for (int b = 0; b < maxBands; ++b)
+        {
+            const auto v3 = x - ic2[(size_t) b];
+            const auto v1 = a1[(size_t) b] * ic1[(size_t) b] + a2[(size_t) b] * v3;
+            const auto v2 = ic2[(size_t) b] + a2[(size_t) b] * ic1[(size_t) b] + a3[(size_t) b] * v3;
+            ic1[(size_t) b] = v1 + v1 - ic1[(size_t) b];
+            ic2[(size_t) b] = v2 + v2 - ic2[(size_t) b];
+            
+            // k times the band pass output has unity gain at the centre frequency
+            const auto level = std::abs(k[(size_t) b] * v1);
+            const auto coefficient = level > envelope[(size_t) b] ? attack : release;
+            envelope[(size_t) b] += coefficient * (level - envelope[(size_t) b]);
+        }
+    }
+    
+    // one dB of gain change per dB above the threshold, up to the range, in either direction
+    for (int b = 0; b < maxBands; ++b)
+    {
+        const auto over = juce::jmax(0.f, juce::Decibels::gainToDecibels(envelope[(size_t) b]) - threshold[(size_t) b]);
+        const auto bandRange = range[(size_t) b];
+        gainOffsets[(size_t) b] = bandRange < 0.f ? juce::jmax(bandRange, -over) : juce::jmin(bandRange, over);
+    }
+}
+
+//==============================================================================
+/*
+ the OS semaphore each worker sleeps on. Posting it is an atomic increment plus, only when
+ the worker is asleep, a kernel wake up; unlike juce::WaitableEvent there is no mutex for
+ the audio thread to contend on
+ */
+struct MultiChannelChain::WakeUpSemaphore
+{
+   #if JUCE_MAC || JUCE_IOS
+    WakeUpSemaphore() : semaphore(dispatch_semaphore_create(0)) {}
+    ~WakeUpSemaphore() { dispatch_release(semaphore); }
+    void post() { dispatch_semaphore_signal(semaphore); }
+    void wait() { dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER); }
+    dispatch_semaphore_t semaphore;
+   #elif JUCE_WINDOWS
+    WakeUpSemaphore() : semaphore(CreateSemaphoreW(nullptr, 0, LONG_MAX, nullptr)) {}
+    ~WakeUpSemaphore() { CloseHandle(semaphore); }
+    void post() { ReleaseSemaphore(semaphore, 1, nullptr); }
+    void wait() { WaitForSingleObject(semaphore, INFINITE); }
+    HANDLE semaphore;
+   #else
+    WakeUpSemaphore() { sem_init(&semaphore, 0, 0); }
+    ~WakeUpSemaphore() { sem_destroy(&semaphore); }
+    void post() { sem_post(&semaphore); }
+    void wait() { while (sem_wait(&semaphore) != 0 && errno == EINTR) {} }
+    sem_t semaphore;
+   #endif
+};
+
+// tells the core it is in a spin loop, so a hyperthreaded sibling gets the execution units
+static inline void pauseWhileSpinning()
+{
+   #if JUCE_INTEL
+    _mm_pause();
+   #elif JUCE_ARM && (JUCE_CLANG || JUCE_GCC)
+    __asm__ __volatile__ ("yield");
+   #endif
+}
+
+// sleeps until the audio thread has groups to share out, then helps to process them
+struct MultiChannelChain::Worker : juce::Thread
+{
+    Worker(MultiChannelChain& chain) : juce::Thread("SimpleEQ Channel Worker"), owner(chain)
+    {
+        // the audio thread waits on any group a worker has claimed, so a worker must not be
+        // preempted by ordinary threads. Without realtime permissions it runs as high as it can
+        if (!startRealtimeThread(juce::Thread::RealtimeOptions{}.withPriority(10)))
+            startThread(juce::Thread::Priority::highest);
+    }
+    
+    ~Worker() override
+    {
+        signalThreadShouldExit();
+        wakeUp.post();
+        stopThread(1000);
+    }
+    
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            wakeUp.wait();
+            
+            if (!threadShouldExit())
+                owner.runGroups();
+        }
+    }
+    
+    MultiChannelChain& owner;
+    WakeUpSemaphore wakeUp;
+};
+
+MultiChannelChain::~MultiChannelChain() = default;
+
+void MultiChannelChain::prepare(int numChannels, int maximumBlockSize, bool useWorkers)
+{
+    // no worker may be looking at the groups while they change
+    workers.clear();
+    
+    numGroups = (numChannels + numLanes - 1) / numLanes;
+    groups.resize((size_t) numGroups);
+    
+    for (int g = 0; g < numGroups; ++g)
+    {
+        auto& group = groups[(size_t) g];
+        if (group == nullptr)
+            group = std::make_unique<Group>();
+        
+        group->firstChannel = g * numLanes;
+        group->numChannels = juce::jmin(numLanes, numChannels - group->firstChannel);
+        
+        // a single lane is processed straight in the buffer
+        if (numLanes > 1)
+            group->interleaved.assign((size_t) maximumBlockSize, Vec(0.f));
+    }
+    
+    // everything claimed, until the next block hands out work
+    nextGroup = numGroups;
+    groupsDone = numGroups;
+    
+    // the audio thread takes a share of the groups itself
+    if (useWorkers && numGroups >= minGroupsForWorkers)
+        for (int i = 0; i < juce::jmin(maxWorkers, numGroups - 1); ++i)
+            workers.push_back(std::make_unique<Worker>(*this));
+    
+    reset();
+}
+
+void MultiChannelChain::reset()
+{
+    for (auto& group : groups)
+        group->cascade.reset();
+}
+
+void MultiChannelChain::setStateSpaceEnabled(bool shouldBeEnabled)
+{
+    for (auto& group : groups)
+        group->cascade.setStateSpaceEnabled(shouldBeEnabled);
+}
+
+void MultiChannelChain::setCoefficients(const ChainCoefficients& left, const ChainCoefficients& right, int numSteps)
+{
+    for (auto& group : groups)
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+            group->cascade.setLaneCoefficients(lane, (group->firstChannel + lane == 0) ? left : right, numSteps);
+        
+        group->cascade.commit();
+    }
+}
+
+void MultiChannelChain::setBypassStates(const ChainSettings& left, const ChainSettings& right)
+{
+    for (auto& group : groups)
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+            group->cascade.setLaneBypassStates(lane, (group->firstChannel + lane == 0) ? left : right);
+        
+        group->cascade.commit();
+    }
+}
+
+void MultiChannelChain::setDynamicGains(const std::array<float, maxBands>& left, const std::array<float, maxBands>& right)
+{
+    for (auto& group : groups)
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+            group->cascade.setLaneDynamicGains(lane, (group->firstChannel + lane == 0) ? left : right);
+        
+        group->cascade.updateDynamicSections();
+    }
+}
+
+void MultiChannelChain::advanceSmoothing()
+{
+    for (auto& group : groups)
+        group->cascade.advanceSmoothing();
+}
+
+bool MultiChannelChain::isIdentity() const
+{
+    return std::all_of(groups.begin(), groups.end(), [](const auto& group) { return group->cascade.isIdentity(); });
+}
+
+void MultiChannelChain::process(const juce::dsp::AudioBlock<float>& block)
+{
+    jassert((int) block.getNumChannels() >= (groups.empty() ? 0 : groups.back()->firstChannel + groups.back()->numChannels));
+    
+    // flat groups return straight away, so only the rest are worth sharing out
+    const auto numBusyGroups = (int) std::count_if(groups.begin(), groups.end(), [](const auto& group) { return !group->cascade.isIdentity(); });
+    
+    if (workers.empty() || numBusyGroups < minGroupsForWorkers)
+    {
+        // without SIMD every channel is filtered in place, so mid/side takes a pass either side.
+        // it is stereo only, which is never enough groups for workers
+        const auto midSidePasses = numLanes == 1 && midSide && block.getNumChannels() >= 2;
+        
+        if (midSidePasses)
+            encodeMidSide(block.getChannelPointer(0), block.getChannelPointer(1), (int) block.getNumSamples());
+        
+        for (auto& group : groups)
+            processGroup(*group, block);
+        
+        if (midSidePasses)
+            decodeMidSide(block.getChannelPointer(0), block.getChannelPointer(1), (int) block.getNumSamples());
+        
+        return;
+    }
+    
+    // hand the groups out, then work through them alongside the workers. The audio thread
+    // never waits on a worker to wake up, only for groups a worker has already started on
+    currentBlock = block;
+    groupsDone.store(0, std::memory_order_relaxed);
+    nextGroup.store(0, std::memory_order_release);
+    
+    for (auto& worker : workers)
+        worker->wakeUp.post();
+    
+    runGroups();
+    
+    // a claimed group is a few microseconds of work, so spin on it for a while before
+    // handing the core back between checks, in case the worker did get preempted
+    for (int spins = 0; groupsDone.load(std::memory_order_acquire) < numGroups; ++spins)
+    {
+        if (spins < maxSpins)
+            pauseWhileSpinning();
+        else
+            juce::Thread::yield();
+    }
+}
+
+void MultiChannelChain::runGroups()
+{
+    for (;;)
+    {
+        auto g = nextGroup.fetch_add(1, std::memory_order_acq_rel);
+        if (g >= numGroups)
+            return;
+        
+        processGroup(*groups[(size_t) g], currentBlock);
+        groupsDone.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void MultiChannelChain::processGroup(Group& group, const juce::dsp::AudioBlock<float>& block)
+{
+    // a flat chain doesn't need to touch the buffer at all
+    if (group.cascade.isIdentity())
+        return;
+    
+    const auto numSamples = (int) block.getNumSamples();
+    
+    if constexpr (numLanes == 1)
+    {
+        group.cascade.process(reinterpret_cast<Vec*>(block.getChannelPointer((size_t) group.firstChannel)), numSamples);
+    }
+    else
+    {
+        jassert(numSamples <= (int) group.interleaved.size());
+        
+        // interleave the channels, so every sample frame is one register
+        auto* frames = reinterpret_cast<float*>(group.interleaved.data());
+        
+        // mid/side is encoded while interleaving, so it costs no pass of its own
+        const auto midSideLanes = midSide && group.firstChannel == 0 && group.numChannels >= 2;
+        const auto firstPlainLane = midSideLanes ? 2 : 0;
+        
+        if (midSideLanes)
+        {
+            const auto* left = block.getChannelPointer(0);
+            const auto* right = block.getChannelPointer(1);
+            for (int i = 0; i < numSamples; ++i)
+            {
+                frames[i * numLanes] = 0.5f * (left[i] + right[i]);
+                frames[i * numLanes + 1] = 0.5f * (left[i] - right[i]);
+            }
+        }
+        
+        for (int lane = firstPlainLane; lane < group.numChannels; ++lane)
+        {
+            auto* channel = block.getChannelPointer((size_t) (group.firstChannel + lane));
+            for (int i = 0; i < numSamples; ++i)
+                frames[i * numLanes + lane] = channel[i];
+        }
+        
+        // lanes without a channel are fed silence, rather than their own output again
+        for (int lane = group.numChannels; lane < numLanes; ++lane)
+            for (int i = 0; i < numSamples; ++i)
+                frames[i * numLanes + lane] = 0.f;
+        
+        group.cascade.process(group.interleaved.data(), numSamples);
+        
+        if (midSideLanes)
+        {
+            auto* left = block.getChannelPointer(0);
+            auto* right = block.getChannelPointer(1);
+            for (int i = 0; i < numSamples; ++i)
+            {
+                left[i] = frames[i * numLanes] + frames[i * numLanes + 1];
+                right[i] = frames[i * numLanes] - frames[i * numLanes + 1];
+            }
+        }
+        
+        for (int lane = firstPlainLane; lane < group.numChannels; ++lane)
+        {
+            auto* channel = block.getChannelPointer((size_t) (group.firstChannel + lane));
+            for (int i = 0; i < numSamples; ++i)
+                channel[i] = frames[i * numLanes + lane];
+        }
+    }
+}
+
+//==============================================================================
+void MultiStreamEQ::prepare(int newNumStreams, double newSampleRate)
+{
+    numStreams = newNumStreams;
+    sampleRate = newSampleRate;
+    
+    groups.clear();
+    for (int g = 0; g < (numStreams + numLanes - 1) / numLanes; ++g)
+        groups.push_back(std::make_unique<FilterCascade<Vec>>());
+    
+    if (numLanes > 1)
+        interleaved.assign((size_t) chunkSize, Vec(0.f));
+    
+    // every stream starts out flat, with the parameter defaults and all filters bypassed
+    ChainSettings flat;
+    flat.lowCutFreq = 20.f;
+    flat.highCutFreq = 20000.f;
+    flat.lowCutBypassed = flat.highCutBypassed = true;
+    
+    for (int i = 0; i < maxBands; ++i)
+        flat.bands[(size_t) i] = { getDefaultBandFrequency(i), 0.f, 1.f, true };
+    
+    for (int stream = 0; stream < numStreams; ++stream)
+        setStreamSettings(stream, flat);
+    
+    reset();
+}
+
+void MultiStreamEQ::reset()
+{
+    for (auto& group : groups)
+        group->reset();
+}
+
+void MultiStreamEQ::setStreamSettings(int stream, const ChainSettings& chainSettings)
+{
+    jassert(stream >= 0 && stream < numStreams);
+    
+    auto& group = *groups[(size_t) (stream / numLanes)];
+    const auto lane = stream % numLanes;
+    
+    group.setLaneCoefficients(lane, makeChainCoefficients(chainSettings, sampleRate), 0);
+    group.setLaneBypassStates(lane, chainSettings);
+}
+
+void MultiStreamEQ::process(float* data, int streamStride, int numSamples)
+{
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        auto& group = *groups[g];
+        
+        // picks up every stream of the group that changed since the last call
+        group.commit();
+        
+        if (group.isIdentity())
+            continue;
+        
+        const auto firstStream = (int) g * numLanes;
+        const auto numGroupStreams = juce::jmin(numLanes, numStreams - firstStream);
+        
+        if constexpr (numLanes == 1)
+        {
+            group.process(reinterpret_cast<Vec*>(data + firstStream * streamStride), numSamples);
+        }
+        else
+        {
+            auto* frames = reinterpret_cast<float*>(interleaved.data());
+            
+            for (int start = 0; start < numSamples; start += chunkSize)
+            {
+                const auto length = juce::jmin(chunkSize, numSamples - start);
+                
+                for (int lane = 0; lane < numLanes; ++lane)
+                {
+                    // lanes past the last stream are fed silence
+                    const auto* stream = lane < numGroupStreams ? data + (firstStream + lane) * streamStride + start : nullptr;
+                    for (int i = 0; i < length; ++i)
+                        frames[i * numLanes + lane] = stream != nullptr ? stream[i] : 0.f;
+                }
+                
+                group.process(interleaved.data(), length);
+                
+                for (int lane = 0; lane < numGroupStreams; ++lane)
+                {
+                    auto* stream = data + (firstStream + lane) * streamStride + start;
+                    for (int i = 0; i < length; ++i)
+                        stream[i] = frames[i * numLanes + lane];
+                }
+            }
+        }
+    }
+}
+
+// adds the filter parameters of one channel, every ID and name starting with prefix
+static void addChainParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout, const juce::String& prefix)
+{
+    // low cut, high cut frequency
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(prefix + "LowCut Freq", 1), prefix + "LowCut Freq", juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), 20.f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(prefix + "HighCut Freq", 1), prefix + "HighCut Freq", juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), 20000.f));
+    
+    auto addBandParameters = [&layout, &prefix](int band)
+    {
+        const auto name = prefix + "Band" + juce::String(band + 1);
+        layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(name + " Freq", 1), name + " Freq", juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), getDefaultBandFrequency(band)));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(name + " Gain", 1), name + " Gain", juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f), 0.f));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(name + " Quality", 1), name + " Quality", juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f), 1.f));
+    };
+    
+    // band filter 1 to 3 frequency, gain, and quality
+    for (int band = 0; band < 3; ++band)
+        addBandParameters(band);
+    
+    // string array for slope
+    juce::StringArray slopeArray;
+    for (int i = 0; i<4; ++i){
+        juce::String str;
+        str << (12 + i*12);
+        str << " db/Oct";
+        slopeArray.add(str);
+    }
+    
+    // low cut, high cut slopes
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID(prefix + "LowCut Slope", 1), prefix + "LowCut Slope", slopeArray, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID(prefix + "HighCut Slope", 1), prefix + "HighCut Slope", slopeArray, 0));
     
     // bypass bottons
-    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("LowCut Bypassed", 1), "LowCut Bypassed", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("HighCut Bypassed", 1), "HighCut Bypassed", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("Band1 Bypassed", 1), "Band1 Bypassed", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("Band2 Bypassed", 1), "Band2 Bypassed", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("Band3 Bypassed", 1), "Band3 Bypassed", false));
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID(prefix + "LowCut Bypassed", 1), prefix + "LowCut Bypassed", false));
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID(prefix + "HighCut Bypassed", 1), prefix + "HighCut Bypassed", false));
+    for (int band = 0; band < 3; ++band)
+        layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID(prefix + "Band" + juce::String(band + 1) + " Bypassed", 1), prefix + "Band" + juce::String(band + 1) + " Bypassed", false));
+    
+    // the bands past the editor's three come last, so the original parameters keep their order
+    for (int band = 3; band < maxBands; ++band)
+    {
+        addBandParameters(band);
+        layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID(prefix + "Band" + juce::String(band + 1) + " Bypassed", 1), prefix + "Band" + juce::String(band + 1) + " Bypassed", false));
+    }
+    
+    // dynamic EQ: each band can move its gain by up to range dB once its detector passes the threshold
+    for (int band = 0; band < maxBands; ++band)
+    {
+        const auto name = prefix + "Band" + juce::String(band + 1);
+        layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID(name + " Dynamic", 1), name + " Dynamic", false));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(name + " Threshold", 1), name + " Threshold", juce::NormalisableRange<float>(-60.f, 0.f, 0.5f, 1.f), -24.f));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(name + " Range", 1), name + " Range", juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f), -6.f));
+    }
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout
+SimpleEQAudioProcessor::createParameterLayout()
+{
+    // use AudioParameterFloat type for the parameters
+//    std::vector<std::unique_ptr<juce::RangedAudioParameter>> params;
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    
+    addChainParameters(layout, {});
+    
+    // the right channel's own settings, only used when the channels aren't linked
+    addChainParameters(layout, secondChannelPrefix);
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("Stereo Link", 1), "Stereo Link", true));
+    
+    // equalise mid and side instead of left and right, stereo layouts only
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("Mid Side", 1), "Mid/Side", false));
+    
+    // how many of the bands are processed, changing it never allocates
+    layout.add(std::make_unique<juce::AudioParameterInt>(juce::ParameterID("Active Bands", 1), "Active Bands", 1, maxBands, 3));
+    
+    // the dynamic bands' envelope times, and whether the sidechain bus keys them
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Dynamic Attack", 1), "Dynamic Attack", juce::NormalisableRange<float>(0.1f, 200.f, 0.1f, 0.4f), 10.f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID("Dynamic Release", 1), "Dynamic Release", juce::NormalisableRange<float>(5.f, 2000.f, 1.f, 0.4f), 150.f));
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("Dynamic Sidechain", 1), "Dynamic Sidechain", false));
+    
+    // direct form biquads or TPT state variable filters
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Filter Engine", 1), "Filter Engine",
+                                                            juce::StringArray {"Biquad", "SVF"}, 0));
+    
+    // oversampling for the cascade, the processor prepares itself again when it changes
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Oversampling", 1), "Oversampling",
+                                                            juce::StringArray {"Off", "2x", "4x"}, 0));
+    
+    // linear phase mode, changing its latency setting prepares the processor again
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("Linear Phase", 1), "Linear Phase", false));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Linear Phase Latency", 1), "Linear Phase Latency",
+                                                            juce::StringArray {"Low", "Medium", "High"}, 1));
+    
     layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("Analyzer Enabled", 1), "Analyzer Enabled", true));
     
     return layout;
@@ -12,67 +12,64 @@
 
 //MODIFIED by zyinmatrix
 #include <array>
+/*
+ single producer, single consumer triple buffer that always hands the consumer
+ the most recently published value. Neither side ever waits or allocates: the producer
+ fills its slot in place, the consumer reads in place or swaps out of its slot, and
+ publishing only exchanges slot indices, so no value is ever copy-assigned across threads.
+ */
 template<typename T>
-struct Fifo
+struct LatestValueMailbox
 {
-    void prepare(int numChannels, int numSamples)
-    {
-        static_assert( std::is_same_v<T, juce::AudioBuffer<float>>,
-                      "prepare(numChannels, numSamples) should only be used when the Fifo is holding juce::AudioBuffer<float>");
-        for( auto& buffer : buffers)
-        {
-            buffer.setSize(numChannels,
-                           numSamples,
-                           false,   //clear everything?
-                           true,    //including the extra space?
-                           true);   //avoid reallocating if you can?
-            buffer.clear();
-        }
-    }
+    // slots change hands by index and are swapped out, never copied, so their storage
+    // only ever moves between slots and the consumer's own objects
+    static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>,
+                  "mailbox slots have to move without allocating or throwing");
+    static_assert(std::is_nothrow_swappable_v<T>, "the consumer swaps values out of its slot");
     
-    void prepare(size_t numElements)
-    {
-        static_assert( std::is_same_v<T, std::vector<float>>,
-                      "prepare(numElements) should only be used when the Fifo is holding std::vector<float>");
-        for( auto& buffer : buffers )
-        {
-            buffer.clear();
-            buffer.resize(numElements, 0);
-        }
-    }
+    LatestValueMailbox() = default;
     
-    bool push(const T& t)
+    // producer side: fill in the write slot, then publish it
+    T& getWriteSlot() { return slots[writeIndex]; }
+    
+    void publish()
     {
-        auto write = fifo.write(1);
-        if( write.blockSize1 > 0 )
-        {
-            buffers[write.startIndex1] = t;
-            return true;
-        }
-        
-        return false;
+        auto previous = state.exchange(writeIndex | newDataFlag, std::memory_order_acq_rel);
+        writeIndex = previous & indexMask;
     }
     
-    bool pull(T& t)
+    // consumer side: returns true if a new value was swapped into the read slot
+    bool acquire()
     {
-        auto read = fifo.read(1);
-        if( read.blockSize1 > 0 )
-        {
-            t = buffers[read.startIndex1];
-            return true;
-        }
+        if ((state.load(std::memory_order_relaxed) & newDataFlag) == 0)
+            return false;
         
-        return false;
+        auto previous = state.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & indexMask;
+        return true;
     }
     
-    int getNumAvailableForReading() const
+    const T& getReadSlot() const { return slots[readIndex]; }
+    
+    // the consumer owns the read slot until its next acquire, so it may swap out of it
+    T& getReadSlot() { return slots[readIndex]; }
+    
+    // sizes every slot up front, only while neither side is running
+    template<typename PrepareFn>
+    void prepareSlots(PrepareFn&& prepareSlot)
     {
-        return fifo.getNumReady();
+        for (auto& slot : slots)
+            prepareSlot(slot);
     }
 private:
-    static constexpr int Capacity = 30;
-    std::array<T, Capacity> buffers;
-    juce::AbstractFifo fifo {Capacity};
+    static constexpr int indexMask = 3;
+    static constexpr int newDataFlag = 4;
+    
+    std::array<T, 3> slots;
+    int writeIndex = 0, readIndex = 1;
+    std::atomic<int> state {2};
+    
+    JUCE_DECLARE_NON_COPYABLE(LatestValueMailbox)
 };
 
 enum Channel
@@ -84,6 +81,12 @@ enum Channel
     Right //effectively 1
 };
 
+/*
+ single producer, single consumer ring of raw samples from one channel. The audio thread
+ writes each block with at most two copies, the reader takes out buffers of getSize()
+ samples. A block that doesn't fit is dropped whole and counted, so the reader never sees
+ a gap in the middle of a buffer.
+ */
 template<typename BlockType>
 struct SingleChannelSampleFifo
 {
@@ -96,12 +99,24 @@ struct SingleChannelSampleFifo
     {
         jassert(prepared.get());
         jassert(buffer.getNumChannels() > channelToUse );
-        auto* channelPtr = buffer.getReadPointer(channelToUse);
         
-        for( int i = 0; i < buffer.getNumSamples(); ++i )
+        const auto numSamples = buffer.getNumSamples();
+        if (fifo.getFreeSpace() < numSamples)
         {
-            pushNextSampleIntoFifo(channelPtr[i]);
+            droppedSamples.fetch_add(numSamples, std::memory_order_relaxed);
+            return;
         }
+        
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+        
+        // the second block is only there when the write wraps around
+        auto* channelPtr = buffer.getReadPointer(channelToUse);
+        juce::FloatVectorOperations::copy(ring.data() + start1, channelPtr, size1);
+        if (size2 > 0)
+            juce::FloatVectorOperations::copy(ring.data() + start2, channelPtr + size1, size2);
+        
+        fifo.finishedWrite(size1 + size2);
     }
 
     void prepare(int bufferSize)
@@ -109,43 +124,73 @@ struct SingleChannelSampleFifo
         prepared.set(false);
         size.set(bufferSize);
         
-        bufferToFill.setSize(1,             //channel
-                             bufferSize,    //num samples
-                             false,         //keepExistingContent
-                             true,          //clear extra space
-                             true);         //avoid reallocating
-        audioBufferFifo.prepare(1, bufferSize);
-        fifoIndex = 0;
+        // room for as many buffers as the old queue of whole buffers held, and with small
+        // buffers at least two of the largest reads plus the block being written
+        ring.assign((size_t) (juce::jmax(numBuffers * bufferSize, 2 * maxReadSize + bufferSize) + 1), 0.f);
+        fifo.setTotalSize((int) ring.size());
+        fifo.reset();
+        droppedSamples = 0;
         prepared.set(true);
     }
+    
+    // frees the ring, update() can't be called again until the next prepare()
+    void release()
+    {
+        prepared.set(false);
+        size.set(0);
+        std::vector<float>().swap(ring);
+        fifo.reset();
+    }
     //==============================================================================
-    int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
+    int getNumCompleteBuffersAvailable() const { return size.get() > 0 ? fifo.getNumReady() / size.get() : 0; }
+    int getNumSamplesAvailable() const { return fifo.getNumReady(); }
+    
+    // the most samples the ring can ever hold, so the most one pull() can ask for
+    int getCapacity() const { return juce::jmax(0, fifo.getTotalSize() - 1); }
     bool isPrepared() const { return prepared.get(); }
     int getSize() const { return size.get(); }
+    
+    // samples the reader was too slow to make room for, since the last prepare()
+    juce::int64 getNumDroppedSamples() const { return droppedSamples.load(std::memory_order_relaxed); }
     //==============================================================================
-    bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
-private:
-    Channel channelToUse;
-    int fifoIndex = 0;
-    Fifo<BlockType> audioBufferFifo;
-    BlockType bufferToFill;
-    juce::Atomic<bool> prepared = false;
-    juce::Atomic<int> size = 0;
+    bool getAudioBuffer(BlockType& buf)
+    {
+        const auto bufferSize = size.get();
+        if (bufferSize == 0 || fifo.getNumReady() < bufferSize)
+            return false;
+        
+        buf.setSize(1, bufferSize, false, false, true);
+        return pull(buf.getWritePointer(0), bufferSize);
+    }
     
-    void pushNextSampleIntoFifo(float sample)
+    // copies the oldest numSamples out of the ring, false if fewer than that are ready
+    bool pull(float* destination, int numSamples)
     {
-        if (fifoIndex == bufferToFill.getNumSamples())
-        {
-            auto ok = audioBufferFifo.push(bufferToFill);
-
-            juce::ignoreUnused(ok);
-            
-            fifoIndex = 0;
-        }
+        if (fifo.getNumReady() < numSamples)
+            return false;
         
-        bufferToFill.setSample(0, fifoIndex, sample);
-        ++fifoIndex;
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(numSamples, start1, size1, start2, size2);
+        
+        juce::FloatVectorOperations::copy(destination, ring.data() + start1, size1);
+        if (size2 > 0)
+            juce::FloatVectorOperations::copy(destination + size1, ring.data() + start2, size2);
+        
+        fifo.finishedRead(size1 + size2);
+        return true;
     }
+private:
+    static constexpr int numBuffers = 30;
+    
+    // the analyzer's largest fft, which bounds how much it reads at a time
+    static constexpr int maxReadSize = 1 << 13;
+    
+    Channel channelToUse;
+    std::vector<float> ring;
+    juce::AbstractFifo fifo {1};
+    std::atomic<juce::int64> droppedSamples {0};
+    juce::Atomic<bool> prepared = false;
+    juce::Atomic<int> size = 0;
 };
 
 //==============================================================================
@@ -159,102 +204,1147 @@ enum Slope
     Slope_48
 };
 
-// struct that stores the value of all parameters
-struct ChainSettings
+/*
+ the most bands a build can hold. Build variants set SIMPLEEQ_MAX_BANDS, e.g. to 3 for a
+ lite build or 24 for a large one, which strips the unused capacity from every band array,
+ the filter cascades and the parameter layout
+ */
+#ifndef SIMPLEEQ_MAX_BANDS
+ #define SIMPLEEQ_MAX_BANDS 8
+#endif
+
+static constexpr int maxBands = SIMPLEEQ_MAX_BANDS;
+static_assert(maxBands >= 3 && maxBands <= 24, "the editor shows three bands, and 24 is the most the cascade is tuned for");
+
+struct BandSettings
 {
-    float band1Freq{0}, band1GainInDecibles{0}, band1Quality{1.f};
-    float band2Freq{0}, band2GainInDecibles{0}, band2Quality{1.f};
-    float band3Freq{0}, band3GainInDecibles{0}, band3Quality{1.f};
+    float freq{0}, gainInDecibels{0}, quality{1.f};
+    bool bypassed {false};
+    
+    // a dynamic band moves its gain by up to range dB, one dB per dB its detector is above threshold
+    bool dynamic {false};
+    float threshold{-24.f}, range{-6.f};
+};
+
+// struct that stores the value of all parameters, packed into whole cache lines
+struct alignas(64) ChainSettings
+{
+    // only the first numBands are processed
+    std::array<BandSettings, maxBands> bands;
+    int numBands {3};
+    
     float lowCutFreq{0}, highCutFreq{0};
     Slope lowCutSlope{Slope::Slope_12}, highCutSlope{Slope::Slope_12};
     
     bool lowCutBypassed {false}, highCutBypassed {false};
-    bool band1Bypassed {false}, band2Bypassed {false}, band3Bypassed {false};
     
+    // envelope times of the dynamic bands' detectors, in milliseconds
+    float dynamicAttack{10.f}, dynamicRelease{150.f};
 };
 
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
 
-using Filter = juce::dsp::IIR::Filter<float>;
-// use processor chain to conect filters
-using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
+// parameter pointers looked up once, so taking a ChainSettings snapshot is just a handful of relaxed loads
+struct alignas(64) ChainParameters
+{
+    // prefix selects one channel's set of parameters, see SimpleEQAudioProcessor::secondChannelPrefix
+    ChainParameters(juce::AudioProcessorValueTreeState& apvts, const juce::String& prefix = {});
+    
+    ChainSettings load() const;
+private:
+    struct BandParameters
+    {
+        std::atomic<float> *freq, *gain, *quality, *bypassed;
+        std::atomic<float> *dynamic, *threshold, *range;
+    };
+    
+    std::array<BandParameters, maxBands> bands;
+    std::atomic<float> *numBands;
+    std::atomic<float> *dynamicAttack, *dynamicRelease;
+    
+    std::atomic<float> *lowCutFreq, *highCutFreq;
+    std::atomic<float> *lowCutSlope, *highCutSlope;
+    std::atomic<float> *lowCutBypassed, *highCutBypassed;
+};
+
+// normalised second order section, stored as plain data so it can be handed to the audio thread
+struct BiquadCoefficients
+{
+    float b0{1.f}, b1{0.f}, b2{0.f}, a1{0.f}, a2{0.f};
+};
 
-using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, Filter, Filter, CutFilter>;
+enum class FilterEngine
+{
+    biquad, // transposed direct form II, like juce::dsp::IIR::Filter
+    svf     // topology preserving (TPT) state variable filters
+};
 
-enum ChainPositions
+/*
+ one TPT state variable filter section: g = tan(pi f / fs), damping k, and how much of
+ the input, band pass and low pass outputs make up the result. Stays stable for any
+ positive g and k, however fast they move.
+ */
+struct SVFCoefficients
 {
-  LowCut,
-  Band1,
-  Band2,
-  Band3,
-  HighCut
+    float g{0.f}, k{2.f}, m0{1.f}, m1{0.f}, m2{0.f};
 };
 
-using Coefficients = Filter::CoefficientsPtr;
-// does not use any member variables, so set it to static
-void updateCoefficients(Coefficients &old, const Coefficients &replacements);
+// the direct form coefficients with the same response, for analysing an SVF section
+BiquadCoefficients toBiquadCoefficients(const SVFCoefficients& coefficients);
 
-Coefficients makeBand1Filter(const ChainSettings& chainSettings, double sampleRate);
-Coefficients makeBand2Filter(const ChainSettings& chainSettings, double sampleRate);
-Coefficients makeBand3Filter(const ChainSettings& chainSettings, double sampleRate);
+/*
+ the parts of a peak filter's design that don't depend on its gain, so a dynamic band
+ can move its gain without any trigonometry. Linear steps between two shapes are valid
+ shapes too, with every one of them giving a stable filter.
+ */
+struct PeakShape
+{
+    float alpha{0.f}, c2{-2.f};  // biquad: sin(w) / 2Q and -2 cos(w)
+    float g{0.f}, inverseQ{1.f}; // SVF: tan(w / 2) and 1 / Q
+    float gainInDecibels{0.f};
+};
 
-template<int Index, typename ChainType, typename CoefficientType>
-void updateSigleCutFilter(ChainType& chain, const CoefficientType& coefficients)
+PeakShape makePeakShape(double sampleRate, float frequency, float quality, float gainInDecibels);
+
+// gain only updates, a handful of multiplies and one exp
+BiquadCoefficients makePeakCoefficients(const PeakShape& shape, float gainInDecibels);
+SVFCoefficients makeSVFPeakCoefficients(const PeakShape& shape, float gainInDecibels);
+
+// every coefficient a filter chain needs, designed off the audio thread
+struct ChainCoefficients
 {
-    updateCoefficients(chain.template get<Index>().coefficients, coefficients[Index]);
-    chain.template setBypassed<Index>(false);
-}
-
-template<typename ChainType, typename CoefficientType>
-void updateCutFilter(ChainType& cutChain,
-                    const CoefficientType& cutCoefficients,
-                    const int& slope)
+    std::array<BiquadCoefficients, 4> lowCut, highCut;
+    std::array<BiquadCoefficients, maxBands> bands;
+    std::array<PeakShape, maxBands> peakShapes;
+    Slope lowCutSlope{Slope::Slope_12}, highCutSlope{Slope::Slope_12};
+    
+    // the SVF engine's sections, the biquads above then hold their equivalent responses
+    std::array<SVFCoefficients, 4> svfLowCut, svfHighCut;
+    std::array<SVFCoefficients, maxBands> svfBands;
+    FilterEngine engine {FilterEngine::biquad};
+};
+
+// left and right channel, identical while the channels are linked
+using StereoSettings = std::array<ChainSettings, 2>;
+using StereoCoefficients = std::array<ChainCoefficients, 2>;
+
+// how long one section keeps ringing, down to the processor's silence threshold
+int getDecayLengthInSamples(const BiquadCoefficients& coefficients);
+
+// how long the enabled part of the cascade keeps ringing after its input goes silent
+int getTailLengthInSamples(const ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings);
+
+// gain of the enabled part of the cascade at a frequency, the response the editor draws
+double getMagnitudeForFrequency(const ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings,
+                                double frequency, double sampleRate);
+
+/*
+ allocation free designs, producing the same coefficients as juce's makePeakFilter and
+ Butterworth high order designs. Safe to call on the audio thread.
+ */
+BiquadCoefficients makePeakCoefficients(double sampleRate, float frequency, float quality, float gainInDecibels);
+std::array<BiquadCoefficients, 4> makeLowCutCoefficients(const ChainSettings& chainSettings, double sampleRate);
+std::array<BiquadCoefficients, 4> makeHighCutCoefficients(const ChainSettings& chainSettings, double sampleRate);
+ChainCoefficients makeChainCoefficients(const ChainSettings& chainSettings, double sampleRate,
+                                        FilterEngine engine = FilterEngine::biquad);
+
+// SVF versions of the peak and Butterworth designs, a single tan per filter
+void makeSVFCoefficients(ChainCoefficients& chainCoefficients, const ChainSettings& chainSettings, double sampleRate);
+
+//==============================================================================
+/*
+ fused LowCut -> Band1..N -> HighCut cascade of second order sections.
+ Every sample is pushed through all active sections in one loop, and the states of
+ the active sections sit next to each other in one aligned array, so a block is
+ read and written once. SampleType is float for a single channel, or a
+ juce::dsp::SIMDRegister<float> to run one channel per lane. The sections are either
+ direct form biquads or TPT state variable filters, following the coefficients' engine.
+ */
+template<typename SampleType>
+struct FilterCascade
 {
-    // bypass all indivitual filters in left/righ high cut filter chains
-    cutChain.template setBypassed<0>(true);
-    cutChain.template setBypassed<1>(true);
-    cutChain.template setBypassed<2>(true);
-    cutChain.template setBypassed<3>(true);
+    // 4 low cut stages, room for every band, 4 high cut stages
+    static constexpr int bandStart = 4;
+    static constexpr int highCutStart = bandStart + maxBands;
+    static constexpr int numSections = highCutStart + 4;
+    static constexpr int numLanes = (int) (sizeof(SampleType) / sizeof(float));
+    
+    void reset()
+    {
+        for (auto& sectionState : parkedState)
+            sectionState.fill(SampleType(0.f));
+        activeState.fill(SampleType(0.f));
+    }
+    
+    // gives every lane the same coefficients, see setLaneCoefficients()
+    void setCoefficients(const ChainCoefficients& chainCoefficients, int numSteps = 0)
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+            setLaneCoefficients(lane, chainCoefficients, numSteps);
+        
+        commit();
+    }
+    
+    // gives every lane the same bypass states, see setLaneBypassStates()
+    void setBypassStates(const ChainSettings& chainSettings)
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+            setLaneBypassStates(lane, chainSettings);
+        
+        commit();
+    }
+    
+    /*
+     moves one lane to a new set of coefficients, either at once or in equal steps spread
+     over numSteps calls to advanceSmoothing(). Linear steps between two stable sections
+     stay stable, because the region of stable a1/a2 pairs is convex.
+     Takes effect on the next commit().
+     */
+    void setLaneCoefficients(int lane, const ChainCoefficients& chainCoefficients, int numSteps)
+    {
+        auto& l = lanes[lane];
+        
+        // the two engines' states don't carry over, so switching starts them from silence
+        if (chainCoefficients.engine != engine)
+        {
+            engine = chainCoefficients.engine;
+            engineChanged = true;
+        }
+        
+        // a cut filter that changes its number of stages can't be interpolated, so it jumps
+        const auto lowCutJumps = chainCoefficients.lowCutSlope != l.lowCutSlope;
+        const auto highCutJumps = chainCoefficients.highCutSlope != l.highCutSlope;
+        
+        l.lowCutSlope = chainCoefficients.lowCutSlope;
+        l.highCutSlope = chainCoefficients.highCutSlope;
+        
+        // sections are laid out in processing order: low cut, bands, high cut
+        for (int i = 0; i < 4; ++i)
+        {
+            l.target[i] = chainCoefficients.lowCut[i];
+            l.target[highCutStart + i] = chainCoefficients.highCut[i];
+            l.svfTarget[i] = chainCoefficients.svfLowCut[i];
+            l.svfTarget[highCutStart + i] = chainCoefficients.svfHighCut[i];
+        }
+        
+        for (int i = 0; i < maxBands; ++i)
+        {
+            l.target[bandStart + i] = chainCoefficients.bands[i];
+            l.svfTarget[bandStart + i] = chainCoefficients.svfBands[i];
+            l.shapeTarget[i] = chainCoefficients.peakShapes[i];
+        }
+        
+        // every lane is set at the same time with the same numSteps, so they share one step
+        // counter. It only restarts when some section actually has somewhere to glide to
+        auto laneGlides = false;
+        auto laneJumped = engineChanged || lowCutJumps || highCutJumps;
+        
+        for (int i = 0; i < numSections; ++i)
+        {
+            const auto band = i - bandStart;
+            const auto isBand = band >= 0 && band < maxBands;
+            
+            // a section already at its target is left alone, whatever else moved
+            const auto settled = isSame(l.current[i], l.target[i]) && isSame(l.svfCurrent[i], l.svfTarget[i])
+                              && (!isBand || isSame(l.shapeCurrent[band], l.shapeTarget[band]));
+            const auto jumps = numSteps <= 0 || engineChanged || (i < bandStart && lowCutJumps) || (i >= highCutStart && highCutJumps);
+            
+            if (jumps && !settled)
+            {
+                l.current[i] = l.target[i];
+                l.svfCurrent[i] = l.svfTarget[i];
+                if (isBand)
+                    l.shapeCurrent[band] = l.shapeTarget[band];
+                
+                laneJumped = true;
+            }
+            
+            const auto glides = !jumps && !settled;
+            laneGlides = laneGlides || glides;
+            
+            // an SVF glides through its g, k and mix, which keeps every step stable
+            l.step[i] = glides ? getStep(l.current[i], l.target[i], numSteps) : BiquadCoefficients{0.f, 0.f, 0.f, 0.f, 0.f};
+            l.svfStep[i] = glides ? getStep(l.svfCurrent[i], l.svfTarget[i], numSteps) : SVFCoefficients{0.f, 0.f, 0.f, 0.f, 0.f};
+            
+            // the shapes dynamic bands are designed from glide along with their sections
+            if (isBand)
+                l.shapeStep[band] = glides ? getStep(l.shapeCurrent[band], l.shapeTarget[band], numSteps) : PeakShape{0.f, 0.f, 0.f, 0.f, 0.f};
+        }
+        
+        if (numSteps <= 0)
+            stepsRemaining = 0;
+        else if (laneGlides)
+            stepsRemaining = numSteps;
+        
+        // gliding sections are rebuilt by advanceSmoothing(), unchanged ones not at all
+        if (laneJumped)
+            needsCommit = true;
+    }
     
-    // enable and set coefficients for indivitual filters according to the high cut slope
-    switch( slope )
+    // takes effect on the next commit()
+    void setLaneBypassStates(int lane, const ChainSettings& chainSettings)
     {
-        case Slope_48:
+        auto& l = lanes[lane];
+        
+        // bands past the active count are left out like bypassed ones, their sections stay parked
+        std::array<bool, maxBands> bandEnabled, dynamic;
+        for (int i = 0; i < maxBands; ++i)
         {
-            updateSigleCutFilter<3>(cutChain, cutCoefficients);
+            bandEnabled[i] = i < chainSettings.numBands && !chainSettings.bands[i].bypassed;
+            dynamic[i] = bandEnabled[i] && chainSettings.bands[i].dynamic;
         }
-        case Slope_36:
+        
+        if (bandEnabled != l.bandEnabled || dynamic != l.dynamic
+            || chainSettings.lowCutBypassed != l.lowCutBypassed
+            || chainSettings.highCutBypassed != l.highCutBypassed)
         {
-            updateSigleCutFilter<2>(cutChain, cutCoefficients);
+            l.bandEnabled = bandEnabled;
+            l.dynamic = dynamic;
+            l.lowCutBypassed = chainSettings.lowCutBypassed;
+            l.highCutBypassed = chainSettings.highCutBypassed;
+            needsCommit = true;
         }
-        case Slope_24:
+    }
+    
+    // rebuilds the sections after lanes were changed, does nothing if none were
+    void commit()
+    {
+        if (!needsCommit)
+            return;
+        
+        needsCommit = false;
+        
+        for (int i = 0; i < numSections; ++i)
+            buildSection(i);
+        
+        if (engineChanged)
+            reset();
+        
+        // a band moved to or away from 0 dB changes which sections have to run
+        updateActiveSections(engineChanged);
+        engineChanged = false;
+        
+        for (int k = 0; k < numActiveSections; ++k)
+            activeCoefficients[k] = sections[activeSections[k]];
+        
+        if constexpr (numLanes == 1)
+            if (useStateSpace)
+                for (int k = 0; k < numActiveSections; ++k)
+                    activeStateSpace[k] = makeStateSpace(activeCoefficients[k], engine);
+    }
+    
+    /*
+     sets the gain offsets, in dB, of one lane's dynamic bands. Only those bands' sections
+     are redesigned, from their shapes, on the next updateDynamicSections()
+     */
+    void setLaneDynamicGains(int lane, const std::array<float, maxBands>& gainOffsets)
+    {
+        lanes[lane].dynamicGain = gainOffsets;
+    }
+    
+    // gives every lane the same gain offsets, see setLaneDynamicGains()
+    void setDynamicGains(const std::array<float, maxBands>& gainOffsets)
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+            setLaneDynamicGains(lane, gainOffsets);
+        
+        updateDynamicSections();
+    }
+    
+    // the cheap counterpart of commit() for dynamic gain changes, which never change the active sections
+    void updateDynamicSections()
+    {
+        if (needsCommit)
         {
-            updateSigleCutFilter<1>(cutChain, cutCoefficients);
+            commit();
+            return;
         }
-        case Slope_12:
+        
+        for (int k = 0; k < numActiveSections; ++k)
         {
-            updateSigleCutFilter<0>(cutChain, cutCoefficients);
+            const auto i = activeSections[k];
+            if (i < bandStart || i >= highCutStart || !isDynamicBand(i - bandStart))
+                continue;
+            
+            buildSection(i);
+            activeCoefficients[k] = sections[i];
+            
+            if constexpr (numLanes == 1)
+                if (useStateSpace)
+                    activeStateSpace[k] = makeStateSpace(activeCoefficients[k], engine);
         }
     }
-}
+    
+    bool isSmoothing() const { return stepsRemaining > 0; }
+    
+    // moves the coefficients one step closer to their targets, called once per control block
+    void advanceSmoothing()
+    {
+        if (stepsRemaining <= 0)
+            return;
+        
+        --stepsRemaining;
+        
+        for (auto& l : lanes)
+        {
+            if (stepsRemaining > 0)
+            {
+                for (int i = 0; i < numSections; ++i)
+                {
+                    auto& c = l.current[i];
+                    const auto& step = l.step[i];
+                    c.b0 += step.b0; c.b1 += step.b1; c.b2 += step.b2;
+                    c.a1 += step.a1; c.a2 += step.a2;
+                    
+                    auto& svf = l.svfCurrent[i];
+                    const auto& svfStep = l.svfStep[i];
+                    svf.g += svfStep.g; svf.k += svfStep.k;
+                    svf.m0 += svfStep.m0; svf.m1 += svfStep.m1; svf.m2 += svfStep.m2;
+                }
+                
+                for (int i = 0; i < maxBands; ++i)
+                {
+                    auto& shape = l.shapeCurrent[i];
+                    const auto& shapeStep = l.shapeStep[i];
+                    shape.alpha += shapeStep.alpha; shape.c2 += shapeStep.c2;
+                    shape.g += shapeStep.g; shape.inverseQ += shapeStep.inverseQ;
+                    shape.gainInDecibels += shapeStep.gainInDecibels;
+                }
+            }
+            else
+            {
+                // land exactly on the target, without accumulated rounding errors
+                l.current = l.target;
+                l.svfCurrent = l.svfTarget;
+                l.shapeCurrent = l.shapeTarget;
+            }
+        }
+        
+        needsCommit = true;
+        commit();
+    }
+    
+    // true when every section is bypassed or passes the signal through unchanged
+    bool isIdentity() const { return numActiveSections == 0; }
+    
+    /*
+     single channel cascades only: advance stateSpaceBlockSize samples per step through
+     precomputed state space matrices, so one channel fills the vector lanes instead of
+     waiting on each section's feedback sample by sample. Cascades already running one
+     channel per lane ignore it
+     */
+    void setStateSpaceEnabled(bool shouldBeEnabled)
+    {
+        useStateSpace = numLanes == 1 && shouldBeEnabled;
+        needsCommit = true;
+        commit();
+    }
+    
+    void process(SampleType* data, int numSamples)
+    {
+        const auto numBlockSamples = numSamples;
+        
+        if constexpr (numLanes == 1)
+        {
+            if (useStateSpace && numActiveSections > 0)
+            {
+                const auto numBlocked = numSamples - numSamples % stateSpaceBlockSize;
+                processStateSpace(data, numBlocked);
+                data += numBlocked;
+                numSamples -= numBlocked;
+            }
+        }
+        
+        // both share the same states, so the remainder picks up where the blocks left off
+        kernel(activeCoefficients.data(), activeState.data(), numBandSections, data, numSamples);
+        
+        if (numDrainingSections > 0)
+            advanceDraining(numBlockSamples);
+    }
+private:
+    // b0, b1, b2, a1, a2 for a biquad, or a1, a2, a3, m0, m1, m2 for an SVF
+    struct Section
+    {
+        SampleType c0, c1, c2, c3, c4, c5;
+    };
+    
+    // the settings of the channel running in one lane
+    struct Lane
+    {
+        std::array<BiquadCoefficients, numSections> current, target, step;
+        std::array<SVFCoefficients, numSections> svfCurrent, svfTarget, svfStep;
+        Slope lowCutSlope{Slope::Slope_12}, highCutSlope{Slope::Slope_12};
+        
+        bool lowCutBypassed {false}, highCutBypassed {false};
+        std::array<bool, maxBands> bandEnabled {};
+        
+        // dynamic bands are designed from their shapes and gain offsets instead of the sections above
+        std::array<PeakShape, maxBands> shapeCurrent, shapeTarget, shapeStep;
+        std::array<bool, maxBands> dynamic {};
+        std::array<float, maxBands> dynamicGain {};
+    };
+    
+    std::array<Lane, numLanes> lanes;
+    int stepsRemaining = 0;
+    bool needsCommit = true;
+    
+    FilterEngine engine = FilterEngine::biquad;
+    bool engineChanged = false;
+    
+    static constexpr int stateSpaceBlockSize = 4;
+    
+    // one section's effect on a block of samples, with h[j][i] being output i's response to input j
+    struct StateSpaceSection
+    {
+        alignas(16) float h[stateSpaceBlockSize][stateSpaceBlockSize];
+        
+        // the outputs' and next states' responses to the two states, and the next states' to the inputs
+        alignas(16) float o[2][stateSpaceBlockSize];
+        alignas(16) float q[2][stateSpaceBlockSize];
+        float p[2][2];
+    };
+    
+    bool useStateSpace = false;
+    std::array<StateSpaceSection, numLanes == 1 ? numSections : 0> activeStateSpace;
+    
+    // every section by position, and the state of the ones that are currently bypassed
+    std::array<Section, numSections> sections;
+    std::array<std::array<SampleType, 2>, numSections> parkedState;
+    
+    // a section runs when any lane has it enabled and it actually changes that lane's signal
+    std::array<bool, numSections> active {};
+    std::array<bool, numSections> identity {};
+    
+    /*
+     samples left for a biquad section that became an identity while running to ring out
+     its residue. Its state only dies away through its own poles, so it keeps running
+     until then instead of being cut off
+     */
+    std::array<int, numSections> drainSamples {};
+    std::array<bool, numSections> draining {};
+    int numDrainingSections = 0;
+    
+    // the sections that have to run, packed in processing order
+    std::array<int, numSections> activeSections;
+    int numActiveSections = 0;
+    alignas(64) std::array<Section, numSections> activeCoefficients;
+    alignas(64) std::array<SampleType, 2 * numSections> activeState;
+    
+    // interleaves one section's lanes, each lane that has it bypassed runs an identity in its place
+    void buildSection(int i)
+    {
+        const auto svf = engine == FilterEngine::svf;
+        alignas(alignof(SampleType)) float values[6][numLanes];
+        bool allIdentity = true, anyActive = false;
+        
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            const auto& l = lanes[lane];
+            const auto laneEnabled = isEnabled(l, i);
+            
+            // a dynamic band is never dropped as an identity, its gain can move at any time
+            const auto band = i - bandStart;
+            const auto dynamic = band >= 0 && band < maxBands && l.dynamic[band];
+            const auto gain = dynamic ? l.shapeCurrent[band].gainInDecibels + l.dynamicGain[band] : 0.f;
+            const auto laneIdentity = !dynamic && (svf ? isIdentitySection(l.svfCurrent[i]) : isIdentitySection(l.current[i]));
+            
+            if (svf)
+            {
+                const auto c = !laneEnabled ? SVFCoefficients{}
+                             : dynamic ? makeSVFPeakCoefficients(l.shapeCurrent[band], gain)
+                                       : l.svfCurrent[i];
+                const auto a1 = 1.f / (1.f + c.g * (c.g + c.k));
+                values[0][lane] = a1; values[1][lane] = c.g * a1; values[2][lane] = c.g * c.g * a1;
+                values[3][lane] = c.m0; values[4][lane] = c.m1; values[5][lane] = c.m2;
+            }
+            else
+            {
+                const auto c = !laneEnabled ? BiquadCoefficients{}
+                             : dynamic ? makePeakCoefficients(l.shapeCurrent[band], gain)
+                                       : l.current[i];
+                values[0][lane] = c.b0; values[1][lane] = c.b1; values[2][lane] = c.b2;
+                values[3][lane] = c.a1; values[4][lane] = c.a2; values[5][lane] = 0.f;
+            }
+            
+            allIdentity = allIdentity && laneIdentity;
+            anyActive = anyActive || (laneEnabled && !laneIdentity);
+        }
+        
+        sections[i] = { fromLanes(values[0]), fromLanes(values[1]), fromLanes(values[2]),
+                        fromLanes(values[3]), fromLanes(values[4]), fromLanes(values[5]) };
+        identity[i] = allIdentity;
+        active[i] = anyActive;
+    }
+    
+    bool isDynamicBand(int band) const
+    {
+        for (const auto& l : lanes)
+            if (l.dynamic[band])
+                return true;
+        
+        return false;
+    }
+    
+    static bool isEnabled(const Lane& l, int section)
+    {
+        if (section < bandStart)
+            return !l.lowCutBypassed && section <= l.lowCutSlope;
+        
+        if (section >= highCutStart)
+            return !l.highCutBypassed && section - highCutStart <= l.highCutSlope;
+        
+        return l.bandEnabled[section - bandStart];
+    }
+    
+    static SampleType fromLanes(const float* values)
+    {
+        if constexpr (numLanes == 1)
+            return values[0];
+        else
+            return SampleType::fromRawArray(values);
+    }
+    
+    static BiquadCoefficients getStep(const BiquadCoefficients& from, const BiquadCoefficients& to, int numSteps)
+    {
+        const auto scale = 1.f / (float) numSteps;
+        return { (to.b0 - from.b0) * scale, (to.b1 - from.b1) * scale, (to.b2 - from.b2) * scale,
+                 (to.a1 - from.a1) * scale, (to.a2 - from.a2) * scale };
+    }
+    
+    static SVFCoefficients getStep(const SVFCoefficients& from, const SVFCoefficients& to, int numSteps)
+    {
+        const auto scale = 1.f / (float) numSteps;
+        return { (to.g - from.g) * scale, (to.k - from.k) * scale,
+                 (to.m0 - from.m0) * scale, (to.m1 - from.m1) * scale, (to.m2 - from.m2) * scale };
+    }
+    
+    static PeakShape getStep(const PeakShape& from, const PeakShape& to, int numSteps)
+    {
+        const auto scale = 1.f / (float) numSteps;
+        return { (to.alpha - from.alpha) * scale, (to.c2 - from.c2) * scale, (to.g - from.g) * scale,
+                 (to.inverseQ - from.inverseQ) * scale, (to.gainInDecibels - from.gainInDecibels) * scale };
+    }
+    
+    // bit for bit, anything else still has somewhere to glide to
+    template<typename Coefficients>
+    static bool isSame(const Coefficients& a, const Coefficients& b)
+    {
+        static_assert(std::is_trivially_copyable_v<Coefficients>, "compared as raw memory");
+        return std::memcmp(&a, &b, sizeof(Coefficients)) == 0;
+    }
+    
+    // numerator equal to denominator, e.g. a peak filter at 0 dB
+    static bool isIdentitySection(const BiquadCoefficients& c)
+    {
+        constexpr auto tolerance = 1.0e-6f;
+        return std::abs(c.b0 - 1.f) < tolerance
+            && std::abs(c.b1 - c.a1) < tolerance
+            && std::abs(c.b2 - c.a2) < tolerance;
+    }
+    
+    /*
+     writes a section as s' = A s + B x, y = C s + D x, keeping the two states the sample
+     kernels use, then unrolls it over a block: y = H x + O s, s' = P s + Q x
+     */
+    static StateSpaceSection makeStateSpace(const Section& section, FilterEngine engine)
+    {
+        double a[2][2], b[2], c[2], d;
+        
+        if (engine == FilterEngine::biquad)
+        {
+            const double b0 = section.c0, b1 = section.c1, b2 = section.c2, a1 = section.c3, a2 = section.c4;
+            a[0][0] = -a1; a[0][1] = 1.0;
+            a[1][0] = -a2; a[1][1] = 0.0;
+            b[0] = b1 - a1 * b0; b[1] = b2 - a2 * b0;
+            c[0] = 1.0; c[1] = 0.0;
+            d = b0;
+        }
+        else
+        {
+            const double a1 = section.c0, a2 = section.c1, a3 = section.c2;
+            const double m0 = section.c3, m1 = section.c4, m2 = section.c5;
+            a[0][0] = 2.0 * a1 - 1.0; a[0][1] = -2.0 * a2;
+            a[1][0] = 2.0 * a2;       a[1][1] = 1.0 - 2.0 * a3;
+            b[0] = 2.0 * a2; b[1] = 2.0 * a3;
+            c[0] = m1 * a1 + m2 * a2; c[1] = m2 * (1.0 - a3) - m1 * a2;
+            d = m0 + m1 * a2 + m2 * a3;
+        }
+        
+        constexpr auto n = stateSpaceBlockSize;
+        StateSpaceSection m {};
+        
+        // C A^i, A^i B and A^i, for i counting up to the block size
+        double ca[2] = { c[0], c[1] };
+        double ab[n][2];
+        double power[2][2] = { { 1.0, 0.0 }, { 0.0, 1.0 } };
+        ab[0][0] = b[0]; ab[0][1] = b[1];
+        
+        for (int i = 0; i < n; ++i)
+        {
+            m.o[0][i] = (float) ca[0];
+            m.o[1][i] = (float) ca[1];
+            
+            const double next[2] = { ca[0] * a[0][0] + ca[1] * a[1][0], ca[0] * a[0][1] + ca[1] * a[1][1] };
+            ca[0] = next[0]; ca[1] = next[1];
+            
+            if (i + 1 < n)
+            {
+                ab[i + 1][0] = a[0][0] * ab[i][0] + a[0][1] * ab[i][1];
+                ab[i + 1][1] = a[1][0] * ab[i][0] + a[1][1] * ab[i][1];
+            }
+            
+            double product[2][2];
+            for (int r = 0; r < 2; ++r)
+                for (int col = 0; col < 2; ++col)
+                    product[r][col] = a[r][0] * power[0][col] + a[r][1] * power[1][col];
+            
+            std::copy(&product[0][0], &product[0][0] + 4, &power[0][0]);
+        }
+        
+        for (int j = 0; j < n; ++j)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                if (i == j)
+                    m.h[j][i] = (float) d;
+                else if (i > j)
+                    m.h[j][i] = (float) (c[0] * ab[i - j - 1][0] + c[1] * ab[i - j - 1][1]);
+            }
+            
+            m.q[0][j] = (float) ab[n - 1 - j][0];
+            m.q[1][j] = (float) ab[n - 1 - j][1];
+        }
+        
+        for (int r = 0; r < 2; ++r)
+            for (int col = 0; col < 2; ++col)
+                m.p[r][col] = (float) power[r][col];
+        
+        return m;
+    }
+    
+    // numSamples has to be a multiple of the block size
+    void processStateSpace(float* data, int numSamples)
+    {
+        constexpr auto n = stateSpaceBlockSize;
+        
+        for (int start = 0; start < numSamples; start += n)
+        {
+            alignas(16) float x[n];
+            std::copy(data + start, data + start + n, x);
+            
+            for (int k = 0; k < numActiveSections; ++k)
+            {
+                const auto& m = activeStateSpace[k];
+                auto* st = activeState.data() + 2 * k;
+                
+                // every output depends on the states and the inputs so far, written so the
+                // inner loops run across the block and vectorise
+                alignas(16) float y[n];
+                for (int i = 0; i < n; ++i)
+                    y[i] = m.o[0][i] * st[0] + m.o[1][i] * st[1];
+                
+                for (int j = 0; j < n; ++j)
+                    for (int i = 0; i < n; ++i)
+                        y[i] += m.h[j][i] * x[j];
+                
+                auto s0 = m.p[0][0] * st[0] + m.p[0][1] * st[1];
+                auto s1 = m.p[1][0] * st[0] + m.p[1][1] * st[1];
+                for (int j = 0; j < n; ++j)
+                {
+                    s0 += m.q[0][j] * x[j];
+                    s1 += m.q[1][j] * x[j];
+                }
+                
+                st[0] = s0;
+                st[1] = s1;
+                std::copy(y, y + n, x);
+            }
+            
+            std::copy(x, x + n, data + start);
+        }
+    }
+    
+    // nothing but the input in the mix
+    static bool isIdentitySection(const SVFCoefficients& c)
+    {
+        constexpr auto tolerance = 1.0e-6f;
+        return std::abs(c.m0 - 1.f) < tolerance
+            && std::abs(c.m1) < tolerance
+            && std::abs(c.m2) < tolerance;
+    }
+    
+    // force repacks even when the same sections stay active, e.g. to switch kernels
+    void updateActiveSections(bool force)
+    {
+        // a running biquad that turned into an identity starts ringing out. An SVF's mix
+        // ignores its states once it is an identity, so it can be dropped straight away.
+        // forcing comes with a reset, which leaves nothing to ring out
+        for (int k = 0; k < numActiveSections; ++k)
+        {
+            const auto i = activeSections[k];
+            if (force)
+            {
+                draining[i] = false;
+            }
+            else if (!active[i] && identity[i] && engine == FilterEngine::biquad && !draining[i])
+            {
+                draining[i] = true;
+                drainSamples[i] = getLaneDecayLength(i);
+            }
+        }
+        
+        std::array<int, numSections> newSections;
+        int numNewSections = 0, numLowCut = 0, numHighCut = 0;
+        numDrainingSections = 0;
+        
+        for (int i = 0; i < numSections; ++i)
+        {
+            if (active[i] || !draining[i] || drainSamples[i] <= 0)
+            {
+                draining[i] = false;
+                
+                if (!active[i])
+                    continue;
+            }
+            else
+            {
+                ++numDrainingSections;
+            }
+            
+            newSections[numNewSections++] = i;
+            
+            if (i < bandStart) ++numLowCut;
+            else if (i >= highCutStart) ++numHighCut;
+        }
+        
+        if (!force && numNewSections == numActiveSections
+            && std::equal(newSections.begin(), newSections.begin() + numNewSections, activeSections.begin()))
+            return;
+        
+        // park the state of the sections that were running, then pack the new ones together.
+        // an identity is only dropped once it has rung out, or when its states don't reach the output
+        for (int k = 0; k < numActiveSections; ++k)
+        {
+            auto index = activeSections[k];
+            if (identity[index] && !draining[index])
+                parkedState[index] = { SampleType(0.f), SampleType(0.f) };
+            else
+                parkedState[index] = { activeState[2 * k], activeState[2 * k + 1] };
+        }
+        
+        activeSections = newSections;
+        numActiveSections = numNewSections;
+        numBandSections = numNewSections - numLowCut - numHighCut;
+        
+        for (int k = 0; k < numActiveSections; ++k)
+        {
+            activeCoefficients[k] = sections[activeSections[k]];
+            activeState[2 * k] = parkedState[activeSections[k]][0];
+            activeState[2 * k + 1] = parkedState[activeSections[k]][1];
+        }
+        
+        // the cut stage counts only change with the slopes or cut bypass states
+        kernel = selectKernel(engine, numLowCut, numHighCut);
+    }
+    
+    // the longest any lane's poles take to ring out through section i
+    int getLaneDecayLength(int i) const
+    {
+        int decay = 0;
+        for (const auto& l : lanes)
+            decay = juce::jmax(decay, getDecayLengthInSamples(l.current[i]));
+        
+        return decay;
+    }
+    
+    // counts the draining sections down, dropping the ones that have rung out
+    void advanceDraining(int numSamples)
+    {
+        auto anyDrained = false;
+        
+        for (int k = 0; k < numActiveSections; ++k)
+        {
+            auto& remaining = drainSamples[activeSections[k]];
+            if (draining[activeSections[k]])
+            {
+                remaining = juce::jmax(0, remaining - numSamples);
+                anyDrained = anyDrained || remaining == 0;
+            }
+        }
+        
+        if (!anyDrained)
+            return;
+        
+        updateActiveSections(false);
+        
+        if constexpr (numLanes == 1)
+            if (useStateSpace)
+                for (int k = 0; k < numActiveSections; ++k)
+                    activeStateSpace[k] = makeStateSpace(activeCoefficients[k], engine);
+    }
+    
+    //==============================================================================
+    template<FilterEngine Engine>
+    static forcedinline SampleType processSection(const Section& c, SampleType* st, SampleType x)
+    {
+        if constexpr (Engine == FilterEngine::biquad)
+        {
+            // transposed direct form II, same as juce::dsp::IIR::Filter
+            auto y = c.c0 * x + st[0];
+            st[0] = c.c1 * x - c.c3 * y + st[1];
+            st[1] = c.c2 * x - c.c4 * y;
+            return y;
+        }
+        else
+        {
+            // trapezoidal integrators, with st[0] and st[1] the band and low pass states
+            auto v3 = x - st[1];
+            auto v1 = c.c0 * st[0] + c.c1 * v3;
+            auto v2 = st[1] + c.c1 * st[0] + c.c2 * v3;
+            st[0] = v1 + v1 - st[0];
+            st[1] = v2 + v2 - st[1];
+            return c.c3 * x + c.c4 * v1 + c.c5 * v2;
+        }
+    }
+    
+    // a fixed number of sections, so the compiler can unroll them completely
+    template<FilterEngine Engine, int NumSections>
+    static forcedinline SampleType processSections(const Section* c, SampleType* st, SampleType x)
+    {
+        for (int k = 0; k < NumSections; ++k)
+            x = processSection<Engine>(c[k], st + 2 * k, x);
+        
+        return x;
+    }
+    
+    // one kernel per engine and low cut/high cut slope combination, only the band count is decided at run time
+    template<FilterEngine Engine, int NumLowCut, int NumHighCut>
+    static void processBlock(const Section* c, SampleType* st, int numBands, SampleType* data, int numSamples)
+    {
+        const auto* bandCoefficients = c + NumLowCut;
+        auto* bandState = st + 2 * NumLowCut;
+        const auto* highCutCoefficients = bandCoefficients + numBands;
+        auto* highCutState = bandState + 2 * numBands;
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto x = processSections<Engine, NumLowCut>(c, st, data[i]);
+            
+            for (int k = 0; k < numBands; ++k)
+                x = processSection<Engine>(bandCoefficients[k], bandState + 2 * k, x);
+            
+            data[i] = processSections<Engine, NumHighCut>(highCutCoefficients, highCutState, x);
+        }
+    }
+    
+    using Kernel = void (*)(const Section*, SampleType*, int, SampleType*, int);
+    
+    template<FilterEngine Engine, int NumLowCut>
+    static Kernel selectKernel(int numHighCut)
+    {
+        switch (numHighCut)
+        {
+            case 1: return &processBlock<Engine, NumLowCut, 1>;
+            case 2: return &processBlock<Engine, NumLowCut, 2>;
+            case 3: return &processBlock<Engine, NumLowCut, 3>;
+            case 4: return &processBlock<Engine, NumLowCut, 4>;
+            default: return &processBlock<Engine, NumLowCut, 0>;
+        }
+    }
+    
+    template<FilterEngine Engine>
+    static Kernel selectKernel(int numLowCut, int numHighCut)
+    {
+        switch (numLowCut)
+        {
+            case 1: return selectKernel<Engine, 1>(numHighCut);
+            case 2: return selectKernel<Engine, 2>(numHighCut);
+            case 3: return selectKernel<Engine, 3>(numHighCut);
+            case 4: return selectKernel<Engine, 4>(numHighCut);
+            default: return selectKernel<Engine, 0>(numHighCut);
+        }
+    }
+    
+    static Kernel selectKernel(FilterEngine engine, int numLowCut, int numHighCut)
+    {
+        return engine == FilterEngine::svf ? selectKernel<FilterEngine::svf>(numLowCut, numHighCut)
+                                           : selectKernel<FilterEngine::biquad>(numLowCut, numHighCut);
+    }
+    
+    int numBandSections = 0;
+    Kernel kernel = &processBlock<FilterEngine::biquad, 0, 0>;
+};
+
+/*
+ envelope followers for the dynamic bands of one set of settings. Each band listens through
+ a band pass at its own frequency and Q, and the bands' states are stored structure-of-arrays,
+ so the inner loop runs across all bands at once and vectorises. Runs at the host rate on the
+ input or sidechain signal, and turns the envelopes into gain offsets after every call.
+ */
+struct DynamicBandDetector
+{
+    void prepare(double sampleRate);
+    void reset();
+    
+    // picks up the settings, only redesigning the detectors when they changed
+    void setSettings(const ChainSettings& chainSettings);
+    
+    // true when any band is dynamic
+    bool isActive() const { return active; }
+    
+    void process(const float* input, int numSamples);
+    
+    // how far each band's gain moves, 0 dB for bands that aren't dynamic
+    const std::array<float, maxBands>& getGainOffsets() const { return gainOffsets; }
+private:
+    double sampleRate = 44100.0;
+    ChainSettings lastSettings;
+    bool needsDesign = true;
+    bool active = false;
+    
+    // band pass coefficients and states, in the same TPT form as the SVF engine
+    std::array<float, maxBands> a1 {}, a2 {}, a3 {}, k {};
+    std::array<float, maxBands> ic1 {}, ic2 {}, envelope {};
+    std::array<float, maxBands> threshold {}, range {}, gainOffsets {};
+    float attack = 1.f, release = 1.f;
+};
+
+/*
+ runs a FilterCascade over any number of channels. The channels are processed in groups
+ of numLanes, one channel per lane of a juce::dsp::SIMDRegister when SIMD is available,
+ and on wide layouts the groups can be shared out among a few worker threads.
+ */
+struct MultiChannelChain
+{
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<float>;
+   #else
+    using Vec = float;
+   #endif
+    
+    static constexpr int numLanes = FilterCascade<Vec>::numLanes;
+    
+    // fewer groups than this aren't worth waking other threads for
+    static constexpr int minGroupsForWorkers = 3;
+    static constexpr int maxWorkers = 3;
+    
+    ~MultiChannelChain();
+    
+    // allocates the groups, and starts or stops worker threads as the channel count needs
+    void prepare(int numChannels, int maximumBlockSize, bool useWorkers);
+    void reset();
+    
+    // channel 0 follows the left settings, every other channel the right ones
+    void setCoefficients(const ChainCoefficients& left, const ChainCoefficients& right, int numSteps);
+    void setBypassStates(const ChainSettings& left, const ChainSettings& right);
+    void setDynamicGains(const std::array<float, maxBands>& left, const std::array<float, maxBands>& right);
+    
+    /*
+     mid/side: the first two channels are encoded into mid and side on their way into the
+     lanes, and decoded on their way out, so left follows the mid settings and right the side
+     ones at the cost of plain stereo
+     */
+    void setMidSide(bool shouldUseMidSide) { midSide = shouldUseMidSide; }
+    
+    // without SIMD every group is a single channel, which can run in blocks of samples too
+    void setStateSpaceEnabled(bool shouldBeEnabled);
+    
+    // all groups are set together, so the first one speaks for all of them
+    bool isSmoothing() const { return !groups.empty() && groups.front()->cascade.isSmoothing(); }
+    void advanceSmoothing();
+    
+    // true when every group passes its channels through unchanged
+    bool isIdentity() const;
+    
+    // processes the prepared number of channels of the block in place
+    void process(const juce::dsp::AudioBlock<float>& block);
+private:
+    struct Group
+    {
+        FilterCascade<Vec> cascade;
+        
+        // the group's channels interleaved into lanes
+        std::vector<Vec> interleaved;
+        int firstChannel = 0, numChannels = 0;
+    };
+    
+    struct Worker;
+    struct WakeUpSemaphore;
+    
+    // pause instructions the audio thread spends on a claimed group before it starts yielding
+    static constexpr int maxSpins = 4096;
+    
+    // each group on its own allocation, so workers don't share cache lines
+    std::vector<std::unique_ptr<Group>> groups;
+    std::vector<std::unique_ptr<Worker>> workers;
+    
+    // the block being processed, and the groups claimed and finished so far
+    juce::dsp::AudioBlock<float> currentBlock;
+    int numGroups = 0;
+    bool midSide = false;
+    std::atomic<int> nextGroup {0};
+    std::atomic<int> groupsDone {0};
+    
+    void processGroup(Group& group, const juce::dsp::AudioBlock<float>& block);
+    void runGroups();
+};
 
-inline auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate)
+/*
+ equalises many independent mono streams in one call, without a plugin around it.
+ Streams are packed numLanes to a register, each lane with its own ChainSettings, so the
+ coefficients and states of a group of streams are stored structure-of-arrays.
+ */
+struct MultiStreamEQ
 {
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq,
-                                                                                      sampleRate,
-                                                                                      2 * (chainSettings.lowCutSlope+1));
-}
-inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate)
+    using Vec = MultiChannelChain::Vec;
+    
+    static constexpr int numLanes = MultiChannelChain::numLanes;
+    
+    // samples interleaved at a time, small enough to stay in the L1 cache
+    static constexpr int chunkSize = 256;
+    
+    // the only call that allocates
+    void prepare(int numStreams, double sampleRate);
+    void reset();
+    
+    int getNumStreams() const { return numStreams; }
+    
+    // designs the stream's filters right away, they are applied on the next process call
+    void setStreamSettings(int stream, const ChainSettings& chainSettings);
+    
+    /*
+     processes every stream in place, with stream s taking up
+     data[s * streamStride] to data[s * streamStride + numSamples - 1]
+     */
+    void process(float* data, int streamStride, int numSamples);
+private:
+    std::vector<std::unique_ptr<FilterCascade<Vec>>> groups;
+    std::vector<Vec> interleaved;
+    int numStreams = 0;
+    double sampleRate = 0.0;
+};
+
+// one background thread shared by every plugin instance for designing filter coefficients
+struct CoefficientDesignThread : juce::TimeSliceThread
 {
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq,
-                                                                                      sampleRate,
-                                                                                      2 * (chainSettings.highCutSlope+1));
-}
+    CoefficientDesignThread() : juce::TimeSliceThread("SimpleEQ Coefficient Designer")
+    {
+        startThread();
+    }
+    
+    ~CoefficientDesignThread() override
+    {
+        stopThread(1000);
+    }
+};
 
 //==============================================================================
 /**
 */
-class SimpleEQAudioProcessor  : public juce::AudioProcessor
+class SimpleEQAudioProcessor  : public juce::AudioProcessor,
+                                public juce::AudioProcessorParameter::Listener,
+                                public juce::TimeSliceClient,
+                                private juce::AsyncUpdater
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
@@ -297,25 +1387,223 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
     
+    //==============================================================================
+    void parameterValueChanged (int parameterIndex, float newValue) override;
+    void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override {}
+    
+    int useTimeSlice() override;
+    
+    // reports the latency of the current phase mode, on the message thread
+    void handleAsyncUpdate() override;
+    
 // MODIFIED by zyinmatrix
     juce::AudioProcessorValueTreeState& getAPVTS() {return apvts;}
+    ChainSettings getChainSettings() const {return chainParameters.load();}
+    
+    // the rate the cascade is designed at, the host's times the oversampling factor
+    double getDesignSampleRate() const { return publishedDesignSampleRate.load(std::memory_order_relaxed); }
+    
+    // parameter ID prefix of the second channel's settings, used by the right channel when unlinked
+    static inline const juce::String secondChannelPrefix {"Ch2 "};
+    
+    // lets layouts with many channels share their channel groups out among worker threads,
+    // takes effect on the next prepareToPlay
+    void setWorkerThreadsEnabled(bool shouldBeEnabled) { workerThreadsEnabled = shouldBeEnabled; }
+    
+    // blocks quieter than this (-120 dB) count as silence, and filter tails are measured down to it
+    static constexpr float silenceThreshold = 1.0e-6f;
+    
+    // coefficient changes are spread over this long, refreshed once every control block
+    static constexpr double smoothingTimeSeconds = 0.02;
+    static constexpr int controlBlockSize = 32;
+    
+    /*
+     schedules a change of the settings at a sample offset within the next processBlock call,
+     for hosts and wrappers that deliver timestamped automation. The block is split at the
+     event and the new coefficients take effect on exactly that sample. settingsIndex 0 is the
+     main set (left, or mid), 1 the second set (right, or side), which is ignored whenever the
+     channels follow the main set. An event's settings, coefficients and bypass states alike,
+     stay in force until the next design from the parameters is picked up. Must be called on
+     the audio thread, returns false when the queue for this block is full.
+     */
+    bool addParameterEvent(int sampleOffset, const ChainSettings& chainSettings, int settingsIndex = 0);
     
     using BlockType = juce::AudioBuffer<float>;
     SingleChannelSampleFifo<BlockType> leftChannelFifo {Channel::Left};
     SingleChannelSampleFifo<BlockType> rightChannelFifo {Channel::Right};
     
+    /*
+     the fifos above are only filled while something reads them, e.g. an open editor, and
+     "Analyzer Enabled" is on. The first consumer allocates their buffers, the last one
+     to leave frees them again. Call from the thread the consumers read on.
+     */
+    void addAnalyzerConsumer();
+    void removeAnalyzerConsumer();
+    
 
 private:
 // MODIFIED by zyinmatrix
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
+    ChainParameters chainParameters {apvts};
+    ChainParameters secondChainParameters {apvts, secondChannelPrefix};
+    std::atomic<float>* stereoLink {apvts.getRawParameterValue("Stereo Link")};
+    
+    bool isStereoLinked() const { return stereoLink->load(std::memory_order_relaxed) > 0.5f; }
+    StereoSettings getStereoSettings() const;
+    
+    std::atomic<float>* linearPhase {apvts.getRawParameterValue("Linear Phase")};
+    std::atomic<float>* linearPhaseLatency {apvts.getRawParameterValue("Linear Phase Latency")};
+    
+    bool isLinearPhase() const { return linearPhase->load(std::memory_order_relaxed) > 0.5f; }
+    
+    std::atomic<float>* filterEngine {apvts.getRawParameterValue("Filter Engine")};
+    FilterEngine getFilterEngine() const { return filterEngine->load(std::memory_order_relaxed) > 0.5f ? FilterEngine::svf : FilterEngine::biquad; }
+    
+    // stereo only: the left settings equalise the mid signal, the right ones (see "Stereo Link") the side
+    std::atomic<float>* midSide {apvts.getRawParameterValue("Mid Side")};
+    bool isMidSide() const { return numChannels == 2 && midSide->load(std::memory_order_relaxed) > 0.5f; }
+    
+    /*
+     2x or 4x oversampling around the cascade, so the bilinear transform's cramping moves
+     above the host's Nyquist. Polyphase half-band IIR stages with integer latency; the
+     coefficients are designed at the oversampled rate. A change is applied from the message
+     thread, by preparing again with processing suspended.
+     */
+    std::atomic<float>* oversamplingChoice {apvts.getRawParameterValue("Oversampling")};
+    std::unique_ptr<juce::dsp::Oversampling<float>> oversampler;
+    int oversamplingFactor = 1;
+    
+    // what the processing was last prepared for, compared by the design thread
+    int preparedOversamplingOrder = 0, preparedLatencyMode = 0;
+    std::atomic<bool> reprepareRequested {false};
+    bool needsReprepare();
+    std::atomic<double> publishedDesignSampleRate {0.0};
+    
+    /*
+     host rate samples the up and down sampling stages add to the cascade's tail: their
+     latency, plus the time each half-band stage's IIR poles need to ring down near Nyquist
+     */
+    static constexpr int halfBandSettlingSamples = 128;
+    int oversamplerTailSamples = 0;
+    
+    // read from the message thread when the latency is reported
+    std::atomic<int> oversamplerLatencySamples {0};
+    
+    int getCurrentLatencySamples() const;
+    void processOversampled(const juce::dsp::AudioBlock<float>& block);
+    void processCascade(const juce::dsp::AudioBlock<float>& block);
+    
+    // mono layouts only run the left chain, wider ones run their channels in groups of SIMD lanes
+    FilterCascade<float> leftChain;
+    MultiChannelChain channelChains;
+    bool monoLayout = false;
+    int numChannels = 0;
+    
+    std::atomic<bool> workerThreadsEnabled {true};
+    
+    // coefficients are designed on the shared background thread and handed to
+    // processBlock through the mailbox, so the audio thread never allocates or locks
+    juce::SharedResourcePointer<CoefficientDesignThread> designThread;
+    juce::CriticalSection designLock;
+    juce::Atomic<bool> parametersChanged {false};
+    double designSampleRate = 0.0;
+    
+    // settings the coefficients were last designed with, used to skip redesigning unchanged filters
+    StereoSettings lastChainSettings;
+    StereoCoefficients designedCoefficients;
+    FilterEngine designedEngine = FilterEngine::biquad;
+    bool filtersNeedFullUpdate = true;
+    
+    LatestValueMailbox<StereoCoefficients> coefficientMailbox;
+    
+    void designCoefficients();
+    void designChannel(const ChainSettings &chainSettings, const ChainSettings &lastSettings, ChainCoefficients &coefficients);
+    void applyCoefficients(const StereoCoefficients &stereoCoefficients, int numSteps);
+    void updateBypassStates(const StereoSettings &stereoSettings);
+    void resetFilters();
+    
+    bool isSmoothing() const;
+    void advanceSmoothing();
+    
+    // a flat chain with no latency path engaged leaves the buffer exactly as it came in
+    bool isPassThrough() const;
+    
+    void processFilters(const juce::dsp::AudioBlock<float>& block);
+    void processSegment(const juce::dsp::AudioBlock<float>& block, size_t detectionStart = 0);
+    void processWithParameterEvents(const juce::dsp::AudioBlock<float>& block);
+    int numSmoothingSteps = 0;
+    
+    // position on the control block grid, which carries on across blocks and events so the
+    // refresh rate and glide time don't follow the host's buffer size
+    int samplesUntilRefresh = 0;
+    
+    // timestamped settings changes for the next block, sorted by sample offset
+    struct ParameterEvent
+    {
+        int sampleOffset;
+        int settingsIndex;
+        ChainSettings settings;
+    };
+    
+    static constexpr int maxParameterEvents = 32;
+    std::array<ParameterEvent, maxParameterEvents> parameterEvents;
+    int numParameterEvents = 0;
+    
+    // what the events have left in force, in place of the parameters' own design
+    StereoSettings eventSettings;
+    StereoCoefficients eventCoefficients;
+    bool eventSettingsActive = false;
+    
+    /*
+     linear phase mode replaces the cascade with a symmetric FIR kernel sampled from its
+     magnitude response. juce::dsp::Convolution handles at most two channels, so there is one
+     per channel pair; it runs uniformly partitioned and crossfades to each new kernel.
+     Kernel length and partition latency follow "Linear Phase Latency", which re-prepares
+     the processor from the message thread like "Oversampling" does.
+     */
+    std::vector<std::unique_ptr<juce::dsp::Convolution>> convolutions;
+    int kernelLength = 0;
+    std::atomic<int> linearPhaseLatencySamples {0};
+    bool lastLinearPhase = false;
+    
+    void prepareLinearPhase(double sampleRate, int samplesPerBlock);
+    void loadLinearPhaseKernels(const StereoSettings &stereoSettings);
+    void processLinearPhase(const juce::dsp::AudioBlock<float>& block);
+    
+    /*
+     dynamic bands: one detector per set of settings, keyed from the input or, with
+     "Dynamic Sidechain" on, from the sidechain bus. Their gain offsets reach the cascades
+     once per control block, as gain only coefficient updates. Linear phase ignores them.
+     */
+    std::atomic<float>* dynamicSidechain {apvts.getRawParameterValue("Dynamic Sidechain")};
+    std::array<DynamicBandDetector, 2> detectors;
+    juce::AudioBuffer<float> detectionBuffer;
+    bool dynamicBandsActive = false;
+    bool separateDetectors = false;
+    
+    void prepareDetection(juce::AudioBuffer<float>& buffer, const StereoSettings& stereoSettings);
+    void detectDynamics(size_t start, size_t length);
+    void applyDynamicGains();
+    
+    /*
+     the analyzer tap, the lock is only ever tried on the audio thread so it never waits.
+     The buffers are only reallocated on the message thread, where the editor reads them
+     */
+    std::atomic<float>* analyzerEnabled {apvts.getRawParameterValue("Analyzer Enabled")};
+    std::atomic<int> analyzerConsumers {0};
+    std::atomic<int> analyzerBlockSize {0};
+    std::atomic<bool> analyzerTapActive {false};
+    int analyzerPreparedSize = 0;
+    juce::SpinLock analyzerLock;
     
-    MonoChain leftChain, rightChain;
-    void updateFilters();
+    void updateAnalyzerTap();
+    void pushToAnalyzer(const juce::AudioBuffer<float>& buffer);
     
-    void updateBandFilters(const ChainSettings &chainSettings);
-    void updateLowCutFilter(const ChainSettings &chainSettings);
-    void updateHighCutFilter(const ChainSettings &chainSettings);
+    // tail of the current cascade, and how long the input has been silent for
+    std::atomic<int> tailLengthSamples {0};
+    int silentSamples = 0;
+    bool sleeping = false;
     
     juce::dsp::Oscillator<float> osc;
 